@@ -0,0 +1,208 @@
+/**
+ * @file probabilities_benchmark.cpp
+ * @brief Measures the time spent computing the rollout probabilities and parameter updates
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <cmath>
+#include "stomp_core/stomp.h"
+
+static const int NUM_DIMENSIONS = 7;          /**< Number of parameters to optimize */
+static const int NUM_TIMESTEPS = 100;         /**< Number of timesteps */
+static const int NUM_ROLLOUTS = 100;          /**< Number of active rollouts */
+static const int NUM_REPETITIONS = 2000;      /**< Number of times each implementation is run */
+static const double MIN_COST_DIFFERENCE = 1e-8; /**< Minimum cost difference allowed during probability calculation */
+
+/** @brief A task that does nothing, only the probability and update steps are exercised */
+class NullTask: public stomp_core::Task
+{
+public:
+
+  bool generateNoisyParameters(const Eigen::MatrixXd& parameters,
+                               std::size_t start_timestep,
+                               std::size_t num_timesteps,
+                               int iteration_number,
+                               int rollout_number,
+                               Eigen::MatrixXd& parameters_noise,
+                               Eigen::MatrixXd& noise) override
+  {
+    return true;
+  }
+
+  bool computeNoisyCosts(const Eigen::MatrixXd& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         int rollout_number,
+                         Eigen::VectorXd& costs,
+                         bool& validity) override
+  {
+    return true;
+  }
+
+  bool computeCosts(const Eigen::MatrixXd& parameters,
+                    std::size_t start_timestep,
+                    std::size_t num_timesteps,
+                    int iteration_number,
+                    Eigen::VectorXd& costs,
+                    bool& validity) override
+  {
+    return true;
+  }
+};
+
+/** @brief Exposes the probability and update steps of Stomp on randomly populated rollouts */
+class StompBenchmark: public stomp_core::Stomp
+{
+public:
+
+  StompBenchmark(const stomp_core::StompConfiguration& config):
+    Stomp(config,stomp_core::TaskPtr(new NullTask()))
+  {
+    num_active_rollouts_ = NUM_ROLLOUTS;
+    for(auto r = 0u; r < num_active_rollouts_; r++)
+    {
+      stomp_core::Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
+      rollout.noise.setRandom();
+      rollout.total_costs = Eigen::MatrixXd::Random(config_.num_dimensions,config_.num_timesteps).cwiseAbs();
+      for(auto d = 0u; d < config_.num_dimensions; d++)
+      {
+        rollout.full_costs[d] = rollout.total_costs.row(d).sum();
+      }
+    }
+  }
+
+  /** @brief Runs the vectorized implementation used by Stomp */
+  const Eigen::MatrixXd& runVectorized()
+  {
+    computeProbabilities();
+    updateParameters();
+    return parameters_updates_;
+  }
+
+  /**
+   * @brief Runs a scalar implementation that visits each rollout element individually.
+   * @param updates The resulting parameter updates
+   */
+  void runScalar(Eigen::MatrixXd& updates)
+  {
+    const double h = config_.exponentiated_cost_sensitivity;
+    std::vector<Eigen::MatrixXd> probabilities(num_active_rollouts_,
+                                               Eigen::MatrixXd::Zero(config_.num_dimensions,config_.num_timesteps));
+    updates.setZero(config_.num_dimensions,config_.num_timesteps);
+    for (auto d = 0u; d<config_.num_dimensions; ++d)
+    {
+      for (auto t = 0u; t<config_.num_timesteps; t++)
+      {
+        double min_cost = rollout(0).total_costs(d,t);
+        double max_cost = min_cost;
+        for (auto r=0u; r<num_active_rollouts_; ++r)
+        {
+          min_cost = std::min(min_cost,rollout(r).total_costs(d,t));
+          max_cost = std::max(max_cost,rollout(r).total_costs(d,t));
+        }
+
+        double denom = std::max(max_cost - min_cost,MIN_COST_DIFFERENCE);
+        double probl_sum = 0.0;
+        for (auto r = 0u; r<num_active_rollouts_; ++r)
+        {
+          probabilities[r](d,t) = rollout(r).importance_weight * exp(-h*(rollout(r).total_costs(d,t) - min_cost)/denom);
+          probl_sum += probabilities[r](d,t);
+        }
+
+        for (auto r = 0u; r<num_active_rollouts_; ++r)
+        {
+          probabilities[r](d,t) /= probl_sum;
+        }
+      }
+
+      for(auto r = 0u; r < num_active_rollouts_; r++)
+      {
+        updates.row(d) += (rollout(r).noise.row(d).array() * probabilities[r].row(d).array()).matrix();
+      }
+    }
+  }
+
+protected:
+
+  stomp_core::Rollout& rollout(int r)
+  {
+    return noisy_rollouts_[rollout_indices_[r]];
+  }
+};
+
+/**
+ * @brief Returns the average time in microseconds taken by a function
+ * @param f The function to time
+ * @return The average time per call in microseconds
+ */
+template <typename Function>
+double timeFunction(Function f)
+{
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < NUM_REPETITIONS; i++)
+  {
+    f();
+  }
+  std::chrono::duration<double,std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count()/NUM_REPETITIONS;
+}
+
+int main(int argc,char** argv)
+{
+  stomp_core::StompConfiguration config;
+  config.num_timesteps = NUM_TIMESTEPS;
+  config.num_iterations = 1;
+  config.num_dimensions = NUM_DIMENSIONS;
+  config.delta_t = 0.1;
+  config.control_cost_weight = 0.0;
+  config.initialization_method = stomp_core::TrajectoryInitializations::LINEAR_INTERPOLATION;
+  config.num_iterations_after_valid = 0;
+  config.num_rollouts = NUM_ROLLOUTS - 1;
+  config.max_rollouts = NUM_ROLLOUTS;
+  config.exponentiated_cost_sensitivity = 10.0;
+
+  StompBenchmark benchmark(config);
+
+  Eigen::MatrixXd scalar_updates;
+  Eigen::MatrixXd vectorized_updates;
+  double scalar_time = timeFunction([&]()
+  {
+    benchmark.runScalar(scalar_updates);
+  });
+
+  double vectorized_time = timeFunction([&]()
+  {
+    vectorized_updates = benchmark.runVectorized();
+  });
+
+  std::cout<<"dimensions: "<<NUM_DIMENSIONS<<", timesteps: "<<NUM_TIMESTEPS<<", rollouts: "<<NUM_ROLLOUTS<<"\n";
+  std::cout<<"scalar:     "<<scalar_time<<" us\n";
+  std::cout<<"vectorized: "<<vectorized_time<<" us\n";
+  std::cout<<"speedup:    "<<scalar_time/vectorized_time<<"x\n";
+  std::cout<<"max update difference: "<<(scalar_updates - vectorized_updates).cwiseAbs().maxCoeff()<<"\n";
+
+  return 0;
+}
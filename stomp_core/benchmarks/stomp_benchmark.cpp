@@ -0,0 +1,306 @@
+/**
+ * @file stomp_benchmark.cpp
+ * @brief Measures the Stomp iteration latency, its breakdown per phase and the throughput over a range of problem
+ * sizes.  The results are printed as csv, or json with '--json'.
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "stomp_core/stomp.h"
+#include "simple_optimization_task.h"
+
+static const double DELTA_T = 0.1;                  /**< Timestep in seconds */
+static const double STD_DEV = 1.0;                  /**< Standard deviation of the noise of every dimension */
+static const double BIAS_THRESHOLD = 0.05;          /**< Threshold to determine whether a dimension matches the bias */
+static const double BIAS_AMPLITUDE = 0.5;           /**< Amplitude of the bump added to the bias so that the optimization has work to do */
+
+/** @brief The problem sizes swept by the benchmark */
+struct BenchmarkSweep
+{
+  std::vector<int> num_timesteps;       /**< @brief The numbers of timesteps */
+  std::vector<int> num_dimensions;      /**< @brief The numbers of dimensions */
+  std::vector<int> num_rollouts;        /**< @brief The numbers of new rollouts per iteration */
+  std::vector<int> max_rollouts_ratios; /**< @brief The max_rollouts as multiples of num_rollouts */
+};
+
+/** @brief The options of the benchmark run */
+struct BenchmarkOptions
+{
+  int num_iterations = 20;              /**< @brief Number of iterations of every solve */
+  int num_repetitions = 3;              /**< @brief Number of solves of every configuration */
+  int num_threads = 1;                  /**< @brief Number of threads used to compute the rollouts state costs */
+  bool json = false;                    /**< @brief Print json instead of csv */
+  bool quick = false;                   /**< @brief Run a reduced sweep */
+};
+
+/** @brief A named value of a benchmark result */
+typedef std::pair<std::string,double> BenchmarkField;
+
+/**
+ * @brief Creates the bias trajectory, a linear interpolation plus a sine bump that vanishes at both ends
+ * @param num_dimensions  The number of dimensions
+ * @param num_timesteps   The number of timesteps
+ * @return The bias trajectory [num_dimensions][num_timesteps]
+ */
+Eigen::MatrixXd createBias(int num_dimensions,int num_timesteps)
+{
+  Eigen::MatrixXd bias(num_dimensions,num_timesteps);
+  for(int d = 0; d < num_dimensions; d++)
+  {
+    double start = 1.0 - 0.1*d;
+    double end = -1.0 + 0.15*d;
+    for(int t = 0; t < num_timesteps; t++)
+    {
+      double s = static_cast<double>(t)/(num_timesteps - 1);
+      bias(d,t) = start + s*(end - start) + BIAS_AMPLITUDE*std::sin(M_PI*s);
+    }
+  }
+
+  return bias;
+}
+
+/**
+ * @brief Runs the configuration repeatedly and gathers the per iteration latency, the phase breakdown and the throughput
+ * @param config    The Stomp configuration
+ * @param options   The benchmark options
+ * @return The benchmark results
+ */
+std::vector<BenchmarkField> runConfiguration(const stomp_core::StompConfiguration& config,
+                                             const BenchmarkOptions& options)
+{
+  using namespace stomp_core;
+  using namespace stomp_core_examples;
+
+  Eigen::MatrixXd bias = createBias(config.num_dimensions,config.num_timesteps);
+  std::vector<double> thresholds(config.num_dimensions,BIAS_THRESHOLD);
+  std::vector<double> std_dev(config.num_dimensions,STD_DEV);
+  Eigen::VectorXd first = bias.leftCols(1);
+  Eigen::VectorXd last = bias.rightCols(1);
+
+  StompStatistics total;
+  std::vector<double> iteration_times;
+  int successes = 0;
+  int threads = 1;
+  for(int i = 0; i < options.num_repetitions; i++)
+  {
+    TaskPtr task(new SimpleOptimizationTask(bias,thresholds,std_dev));
+    srand(i);   // the task seeds from the clock, this keeps the runs reproducible
+    Stomp stomp(config,task);
+
+    Eigen::MatrixXd optimized;
+    StompStatistics stats;
+    successes += stomp.solve(first,last,optimized,&stats) ? 1 : 0;
+
+    int iterations = std::max(stats.iterations,1);
+    iteration_times.push_back(stats.total_time/iterations);
+    total.noise_generation_time += stats.noise_generation_time;
+    total.noisy_filters_time += stats.noisy_filters_time;
+    total.state_costs_time += stats.state_costs_time;
+    total.control_costs_time += stats.control_costs_time;
+    total.probabilities_time += stats.probabilities_time;
+    total.update_filters_time += stats.update_filters_time;
+    total.optimized_cost_time += stats.optimized_cost_time;
+    total.total_time += stats.total_time;
+    total.iterations += stats.iterations;
+    total.rollouts_evaluated += stats.rollouts_evaluated;
+    total.rollouts_reused += stats.rollouts_reused;
+    threads = stats.threads;   // the threads actually used, fewer than requested when the task can not be cloned
+  }
+
+  // phases are reported in microseconds per iteration
+  double us = 1e6/std::max(total.iterations,1);
+  double phases_time = total.noise_generation_time + total.noisy_filters_time + total.state_costs_time +
+      total.control_costs_time + total.probabilities_time + total.update_filters_time + total.optimized_cost_time;
+  double mean_iteration_time = 0;
+  for(double t : iteration_times)
+  {
+    mean_iteration_time += t/iteration_times.size();
+  }
+
+  return {{"timesteps",config.num_timesteps},
+          {"dimensions",config.num_dimensions},
+          {"rollouts",config.num_rollouts},
+          {"max_rollouts",config.max_rollouts},
+          {"threads",threads},
+          {"repetitions",options.num_repetitions},
+          {"successes",successes},
+          {"iterations",total.iterations},
+          {"iteration_us_mean",1e6*mean_iteration_time},
+          {"iteration_us_min",1e6*(*std::min_element(iteration_times.begin(),iteration_times.end()))},
+          {"iteration_us_max",1e6*(*std::max_element(iteration_times.begin(),iteration_times.end()))},
+          {"noise_generation_us",us*total.noise_generation_time},
+          {"noisy_filters_us",us*total.noisy_filters_time},
+          {"state_costs_us",us*total.state_costs_time},
+          {"control_costs_us",us*total.control_costs_time},
+          {"probabilities_us",us*total.probabilities_time},
+          {"update_filters_us",us*total.update_filters_time},
+          {"optimized_cost_us",us*total.optimized_cost_time},
+          {"other_us",us*(total.total_time - phases_time)},
+          {"iterations_per_s",total.iterations/total.total_time},
+          {"rollouts_per_s",total.rollouts_evaluated/total.total_time},
+          {"rollouts_reused",total.rollouts_reused}};
+}
+
+/**
+ * @brief Prints a result as a csv row, the header is printed along with the first row
+ * @param fields    The benchmark results
+ * @param first     Whether this is the first result
+ */
+void printCsv(const std::vector<BenchmarkField>& fields,bool first)
+{
+  if(first)
+  {
+    for(auto i = 0u; i < fields.size(); i++)
+    {
+      std::cout<<(i > 0 ? "," : "")<<fields[i].first;
+    }
+    std::cout<<"\n";
+  }
+
+  for(auto i = 0u; i < fields.size(); i++)
+  {
+    std::cout<<(i > 0 ? "," : "")<<fields[i].second;
+  }
+  std::cout<<std::endl;
+}
+
+/**
+ * @brief Prints a result as an element of a json array, the array is opened along with the first element
+ * @param fields    The benchmark results
+ * @param first     Whether this is the first result
+ */
+void printJson(const std::vector<BenchmarkField>& fields,bool first)
+{
+  std::cout<<(first ? "[\n" : ",\n")<<"  {";
+  for(auto i = 0u; i < fields.size(); i++)
+  {
+    std::cout<<(i > 0 ? ", " : "")<<"\""<<fields[i].first<<"\": "<<fields[i].second;
+  }
+  std::cout<<"}"<<std::flush;
+}
+
+/**
+ * @brief Parses the command line options
+ * @param argc      The number of arguments
+ * @param argv      The arguments
+ * @param options   Receives the options
+ * @return True if all the arguments are valid, otherwise false
+ */
+bool parseOptions(int argc,char** argv,BenchmarkOptions& options)
+{
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if(arg == "--json")
+    {
+      options.json = true;
+    }
+    else if(arg == "--quick")
+    {
+      options.quick = true;
+    }
+    else if(arg == "--iterations" && has_value)
+    {
+      options.num_iterations = std::atoi(argv[++i]);
+    }
+    else if(arg == "--repetitions" && has_value)
+    {
+      options.num_repetitions = std::atoi(argv[++i]);
+    }
+    else if(arg == "--threads" && has_value)
+    {
+      options.num_threads = std::atoi(argv[++i]);
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return options.num_iterations > 0 && options.num_repetitions > 0;
+}
+
+int main(int argc,char** argv)
+{
+  BenchmarkOptions options;
+  if(!parseOptions(argc,argv,options))
+  {
+    std::cerr<<"usage: "<<argv[0]<<" [--quick] [--json] [--iterations N] [--repetitions N] [--threads N]\n";
+    return 1;
+  }
+
+  BenchmarkSweep sweep;
+  if(options.quick)
+  {
+    sweep = {{20,100},{3,7},{10,30},{1,2}};
+  }
+  else
+  {
+    sweep = {{20,50,100,200,500,1000},{3,6,7,12},{10,30,100},{1,2}};
+  }
+
+  stomp_core::StompConfiguration config;
+  config.num_iterations = options.num_iterations;
+  config.num_iterations_after_valid = options.num_iterations;  // every solve runs all the iterations
+  config.delta_t = DELTA_T;
+  config.control_cost_weight = 0.0;
+  config.initialization_method = stomp_core::TrajectoryInitializations::LINEAR_INTERPOLATION;
+  config.num_threads = options.num_threads;
+
+  bool first = true;
+  for(int num_timesteps : sweep.num_timesteps)
+  {
+    for(int num_dimensions : sweep.num_dimensions)
+    {
+      for(int num_rollouts : sweep.num_rollouts)
+      {
+        for(int ratio : sweep.max_rollouts_ratios)
+        {
+          config.num_timesteps = num_timesteps;
+          config.num_dimensions = num_dimensions;
+          config.num_rollouts = num_rollouts;
+          config.max_rollouts = ratio*num_rollouts;
+
+          std::vector<BenchmarkField> fields = runConfiguration(config,options);
+          options.json ? printJson(fields,first) : printCsv(fields,first);
+          first = false;
+        }
+      }
+    }
+  }
+
+  if(options.json)
+  {
+    std::cout<<"\n]"<<std::endl;
+  }
+
+  return 0;
+}
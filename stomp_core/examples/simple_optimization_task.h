@@ -178,6 +178,15 @@ public:
     return smoothParameterUpdates(start_timestep,num_timesteps,iteration_number,updates);
   }
 
+  /**
+   * @brief Creates a copy of the task so that the rollouts can be evaluated by several worker threads, the copy does
+   * not reseed the random number generator.
+   * @return A new task
+   */
+  stomp_core::TaskPtr clone() const override
+  {
+    return stomp_core::TaskPtr(new SimpleOptimizationTask(*this));
+  }
 
 protected:
 
@@ -0,0 +1,108 @@
+/**
+ * @file matrix_cache.h
+ * @brief This contains a process wide cache of the matrices that only depend on the trajectory discretization
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_MATRIX_CACHE_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_MATRIX_CACHE_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+#include "stomp_core/utils.h"
+
+namespace stomp_core
+{
+
+/** @brief Sparse LDL^T factorization that preserves the banded structure of the control cost matrix */
+typedef Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>,Eigen::Lower,Eigen::NaturalOrdering<int> > ControlCostMatrixLDLT;
+
+/** @brief The control cost matrices used by Stomp for a number of timesteps and a timestep size */
+struct ControlCostMatrices
+{
+  Eigen::SparseMatrix<double> finite_diff_matrix_A_padded;  /**< @brief The banded finite difference matrix including padding */
+  Eigen::SparseMatrix<double> control_cost_matrix_R_padded; /**< @brief The banded control cost matrix including padding */
+  Eigen::SparseMatrix<double> control_cost_matrix_R;        /**< @brief A banded matrix [timesteps][timesteps], Referred to as 'R = A x A_transpose' in the literature, scaled so that max(R^-1) == 1 */
+  ControlCostMatrixLDLT control_cost_matrix_R_ldlt;         /**< @brief The factorization of R, used in place of R^-1 */
+};
+
+typedef std::shared_ptr<const ControlCostMatrices> ControlCostMatricesConstPtr;  /**< @brief Shared immutable control cost matrices */
+typedef std::shared_ptr<const Eigen::MatrixXd> MatrixConstPtr;                   /**< @brief A shared immutable matrix */
+
+/**
+ * @brief Gets the control cost matrices from the process wide cache, they are generated on the first request.  The
+ * matrices are shared by all the callers and must not be modified.  This is thread-safe.
+ * @param num_timesteps The number of timesteps
+ * @param dt            The timestep in seconds
+ * @return The control cost matrices, when the factorization of R fails they are returned unscaled and not cached
+ */
+ControlCostMatricesConstPtr getControlCostMatrices(int num_timesteps,double dt);
+
+/**
+ * @brief Gets the smoothing matrix computed by generateSmoothingMatrix from the process wide cache.  This is
+ * thread-safe.
+ * @param num_timesteps The number of timesteps
+ * @param dt            The timestep in seconds
+ * @return The smoothing matrix [timesteps][timesteps]
+ */
+MatrixConstPtr getSmoothingMatrix(int num_timesteps,double dt);
+
+/**
+ * @brief Gets a matrix from the process wide cache, generating it on the first request.  The name distinguishes the
+ * matrices that are computed differently from the same discretization.  This is thread-safe, the generator runs
+ * without holding the cache lock so concurrent first requests may each generate the matrix and the first one stored
+ * is kept.
+ * @param name          The name of the matrix, e.g. "<plugin>/covariance"
+ * @param num_timesteps The number of timesteps
+ * @param dt            The timestep in seconds
+ * @param order         The derivative order the matrix is built from
+ * @param generate      Computes the matrix
+ * @return The cached matrix
+ */
+MatrixConstPtr getCachedMatrix(const std::string& name,int num_timesteps,double dt,
+                               DerivativeOrders::DerivativeOrder order,
+                               const std::function<void (Eigen::MatrixXd&)>& generate);
+
+/**
+ * @brief Removes all the entries from the process wide cache, the matrices still held by callers remain valid.
+ */
+void clearMatrixCache();
+
+/**
+ * @brief Sets the maximum number of entries of the process wide cache, the least recently requested ones are evicted
+ * beyond it.  The matrices still held by callers remain valid.
+ * @param capacity The maximum number of cached matrices, 32 by default
+ */
+void setMatrixCacheCapacity(std::size_t capacity);
+
+/**
+ * @brief Gets the number of entries in the process wide cache.
+ * @return The number of cached matrices
+ */
+std::size_t getMatrixCacheSize();
+
+}
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_MATRIX_CACHE_H_ */
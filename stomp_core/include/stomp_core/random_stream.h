@@ -0,0 +1,130 @@
+/**
+ * @file random_stream.h
+ * @brief This contains a counter based random number generator that yields reproducible independent streams
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_RANDOM_STREAM_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_RANDOM_STREAM_H_
+
+#include <cstdint>
+
+namespace stomp_core
+{
+
+/**
+ * @brief A counter based random number generator.  The n-th value of a stream is a hash of the stream key and n, the
+ * key is derived from a seed and the (iteration, rollout, dimension) that the stream is used for.  Therefore the values
+ * drawn for a rollout do not depend on the order in which the rollouts are generated nor on the thread that generates
+ * them.  A stream holds no shared state, so distinct streams may be used concurrently.
+ */
+class RandomStream
+{
+public:
+
+  /**
+   * @brief Creates the stream of a seed and an (iteration, rollout, dimension) index
+   * @param seed      The seed of the run
+   * @param iteration The iteration number
+   * @param rollout   The rollout number
+   * @param dimension The dimension index
+   */
+  RandomStream(std::uint64_t seed = 0,int iteration = 0,int rollout = 0,int dimension = 0);
+
+  /**
+   * @brief Restarts the stream from its first value with a new key
+   * @param seed      The seed of the run
+   * @param iteration The iteration number
+   * @param rollout   The rollout number
+   * @param dimension The dimension index
+   */
+  void reset(std::uint64_t seed,int iteration = 0,int rollout = 0,int dimension = 0);
+
+  /**
+   * @brief Draws the next value of the stream
+   * @return A uniformly distributed 64 bit integer
+   */
+  std::uint64_t nextInteger()
+  {
+    return mix(key_ + (++counter_)*GOLDEN_GAMMA);
+  }
+
+  /**
+   * @brief Draws a uniformly distributed value in [0, 1)
+   * @return The random value
+   */
+  double nextUniform()
+  {
+    return (nextInteger() >> 11)*(1.0/9007199254740992.0); // 53 bits over 2^53
+  }
+
+  /**
+   * @brief Draws a uniformly distributed value in [min, max)
+   * @param min The lower bound
+   * @param max The upper bound
+   * @return The random value
+   */
+  double nextUniform(double min,double max)
+  {
+    return min + (max - min)*nextUniform();
+  }
+
+  /**
+   * @brief Draws a value from the standard normal distribution using the Box-Muller transform
+   * @return The random value
+   */
+  double nextNormal();
+
+  /**
+   * @brief The number of integers drawn since the stream was created or reset
+   * @return The counter of the stream
+   */
+  std::uint64_t getCounter() const
+  {
+    return counter_;
+  }
+
+protected:
+
+  /**
+   * @brief The SplitMix64 finalizer, a bijective hash with good avalanche
+   * @param z The value to hash
+   * @return The hashed value
+   */
+  static std::uint64_t mix(std::uint64_t z)
+  {
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  static const std::uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;  /**< @brief The Weyl sequence increment */
+
+  std::uint64_t key_;       /**< @brief The hash of the seed and the stream index */
+  std::uint64_t counter_;   /**< @brief The number of values drawn */
+  bool has_spare_normal_;   /**< @brief Whether the second value of the last Box-Muller pair is unused */
+  double spare_normal_;     /**< @brief The second value of the last Box-Muller pair */
+};
+
+}
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_RANDOM_STREAM_H_ */
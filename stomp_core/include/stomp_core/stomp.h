@@ -27,7 +27,14 @@
 #define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_STOMP_H_
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <stomp_core/utils.h>
+#include <stomp_core/stomp_kernels.h>
+#include <stomp_core/matrix_cache.h>
 #include <XmlRpc.h>
 #include "stomp_core/task.h"
 
@@ -45,34 +52,71 @@ public:
    */
   Stomp(const StompConfiguration& config,TaskPtr task);
 
+  /**
+   * @brief Stomp Destructor, stops the worker threads.
+   */
+  ~Stomp();
+
   /**
    * @brief Find the optimal solution provided a start and end goal.
    * @param first Start state for the task
    * @param last Final state for the task
    * @param parameters_optimized Optimized solution [parameters][timesteps]
+   * @param statistics Optional structure that receives the timing and statistics of the optimization
    * @return True if solution was found, otherwise false.
    */
   bool solve(const std::vector<double>& first,const std::vector<double>& last,
-             Eigen::MatrixXd& parameters_optimized);
+             Eigen::MatrixXd& parameters_optimized,StompStatistics* statistics = nullptr);
 
   /**
    * @brief Find the optimal solution provided a start and end goal.
    * @param first Start state for the task
    * @param last Final state for the task
    * @param parameters_optimized Optimized solution [Parameters][timesteps]
+   * @param statistics Optional structure that receives the timing and statistics of the optimization
    * @return True if solution was found, otherwise false.
    */
   bool solve(const Eigen::VectorXd& first,const Eigen::VectorXd& last,
-             Eigen::MatrixXd& parameters_optimized);
+             Eigen::MatrixXd& parameters_optimized,StompStatistics* statistics = nullptr);
 
   /**
    * @brief Find the optimal solution provided an intial guess.
    * @param initial_parameters A matrix [Parameters][timesteps]
    * @param parameters_optimized The optimized solution [Parameters][timesteps]
+   * @param statistics Optional structure that receives the timing and statistics of the optimization.  No timing
+   * is done when it is not provided.
    * @return True if solution was found, otherwise false.
    */
   bool solve(const Eigen::MatrixXd& initial_parameters,
-             Eigen::MatrixXd& parameters_optimized);
+             Eigen::MatrixXd& parameters_optimized,StompStatistics* statistics = nullptr);
+
+  /**
+   * @brief Re-optimizes a window of the initial parameters while the rest of the trajectory is kept fixed, e.g. the
+   * part after the current execution point.  The noise, the state costs and the updates are only computed inside the
+   * window, its first and last timesteps are also kept fixed so that the trajectory remains continuous.
+   * @param initial_parameters A matrix [Parameters][timesteps]
+   * @param start_timestep The first timestep of the window
+   * @param num_timesteps The number of timesteps in the window, at least 3
+   * @param parameters_optimized The optimized solution [Parameters][timesteps]
+   * @param statistics Optional structure that receives the timing and statistics of the optimization
+   * @return True if solution was found, otherwise false.
+   */
+  bool solveWindow(const Eigen::MatrixXd& initial_parameters,int start_timestep,int num_timesteps,
+                   Eigen::MatrixXd& parameters_optimized,StompStatistics* statistics = nullptr);
+
+  /**
+   * @brief Resumes the optimization from the solution and the rollouts of the previous solve, e.g. to replan after a
+   * small change in the task.  The stored rollouts state costs are recomputed over the affected timesteps before
+   * iterating, the costs at the other timesteps are assumed to be unchanged.
+   * @param parameters_optimized The optimized solution [Parameters][timesteps]
+   * @param statistics Optional structure that receives the timing and statistics of the optimization
+   * @param affected_start The first timestep whose state cost may have changed
+   * @param affected_timesteps The number of timesteps whose state cost may have changed, -1 extends to the last timestep
+   * and 0 keeps all the stored costs.
+   * @return True if solution was found, otherwise false.
+   */
+  bool resume(Eigen::MatrixXd& parameters_optimized,StompStatistics* statistics = nullptr,
+              int affected_start = 0,int affected_timesteps = -1);
 
   /**
    * @brief Sets the configuration and resets all internal variables
@@ -93,9 +137,29 @@ public:
    */
   bool clear();
 
+  /**
+   * @brief Gets the lowest cost valid solution found so far by the optimization in progress or by the last one, so that
+   * it can be used before the optimization finishes.  This method is thead-safe.
+   * @param parameters The best valid solution [Parameters][timesteps]
+   * @param cost The cost of the solution
+   * @param iteration The iteration at which the solution was found, 0 when it is the initial trajectory
+   * @return True if a valid solution has been found, otherwise false.
+   */
+  bool getBestSolution(Eigen::MatrixXd& parameters,double& cost,int& iteration) const;
+
 
 protected:
 
+  /** @brief The buffers used to evaluate the rollouts, kept between iterations so that their storage is reused */
+  struct EvaluationWorkspace
+  {
+    Eigen::VectorXd window_costs;                          /**< @brief The costs of a rollout inside the optimization window */
+    std::vector<const Eigen::MatrixXd*> batch_parameters;  /**< @brief The parameters of each rollout in a batch */
+    std::vector<Eigen::VectorXd*> batch_costs;             /**< @brief The costs receiving the results of a batch */
+    std::vector<int> batch_rollout_numbers;                /**< @brief The rollout numbers of a batch */
+    std::vector<Eigen::VectorXd> batch_window_costs;       /**< @brief The costs inside the optimization window of each rollout in a batch */
+  };
+
   // initialization methods
   /**
    * @brief Reset all internal variables.
@@ -111,6 +175,64 @@ protected:
    */
   bool computeInitialTrajectory(const std::vector<double>& first,const std::vector<double>& last);
 
+  /**
+   * @brief Computes the inital guess by optimizing at 'num_coarse_timesteps' and resampling the result to the
+   * full number of timesteps.  The task must support changing its number of timesteps.
+   * @param first Start state for the task
+   * @param last Final state for the task
+   * @return True if sucessful, otherwise false and the task is left at the full number of timesteps.
+   */
+  bool computeCoarseTrajectory(const std::vector<double>& first,const std::vector<double>& last);
+
+  /**
+   * @brief Runs the optimization loop from an initial guess.
+   * @param initial_parameters A matrix [Parameters][timesteps]
+   * @param parameters_optimized The optimized solution [Parameters][timesteps]
+   * @param statistics Optional structure that receives the timing and statistics of the optimization.
+   * @param start_time The time at which the solve started, 'max_solve_time' is measured from it.
+   * @return True if solution was found, otherwise false.
+   */
+  bool optimize(const Eigen::MatrixXd& initial_parameters,Eigen::MatrixXd& parameters_optimized,
+                StompStatistics* statistics,std::chrono::steady_clock::time_point start_time);
+
+  /**
+   * @brief Checks the termination criteria that depend on the cost history, called at the end of each iteration.
+   * Only a valid solution can stop the optimization early.
+   * @return True if the solution is valid and has converged or reached the cost target, otherwise false.
+   */
+  bool hasConverged();
+
+  /**
+   * @brief Checks whether the wall time allowed for the optimization has elapsed.
+   * @return True if the deadline has passed, otherwise false.
+   */
+  bool isPastDeadline() const;
+
+  /**
+   * @brief Creates the tasks used by the worker threads during the parallel evaluation of the rollouts.
+   * The main task is shared when it is thread-safe, otherwise each worker uses a clone.  The clones of previous
+   * optimizations are kept and updated, new ones are only requested for the workers that have none.
+   * @return True if the rollouts can be evaluated in parallel, otherwise false.
+   */
+  bool setupWorkerTasks();
+
+  /**
+   * @brief Starts a worker thread for each worker task, the threads wait for the rollouts of each iteration.
+   */
+  void startWorkers();
+
+  /**
+   * @brief Stops and joins the worker threads.
+   */
+  void stopWorkers();
+
+  /**
+   * @brief The loop run by a worker thread, it evaluates its subset of the rollouts every time it is signaled.
+   * @param w The worker number
+   * @param generation The value of 'workers_generation_' when the worker was started
+   */
+  void runWorker(int w,int generation);
+
   // optimization steps
   /**
    * @brief Run a single iteration of the stomp algorithm
@@ -125,6 +247,12 @@ protected:
    */
   bool generateNoisyRollouts();
 
+  /**
+   * @brief Keeps the noise of a rollout within the interior of the optimization window.
+   * @param rollout The rollout whose noise and noisy parameters are masked
+   */
+  void maskNoise(Rollout& rollout);
+
   /**
    * @brief Applies the optimization task's filter methods to the noisy trajectories.
    * @return True if sucessful, otherwise false.
@@ -137,12 +265,60 @@ protected:
    */
   bool computeNoisyRolloutsCosts();
 
+  /**
+   * @brief Combines the state and control costs of each noisy rollout into its total costs.
+   */
+  void computeRolloutsTotalCosts();
+
+  /**
+   * @brief Recomputes the state costs of the stored rollouts over a range of timesteps.
+   * @param start_timestep The first timestep to recompute
+   * @param num_timesteps The number of timesteps to recompute
+   * @return True if sucessful, otherwise false.
+   */
+  bool recomputeStoredRolloutsCosts(int start_timestep,int num_timesteps);
+
   /**
    * @brief Computes the cost at every timestep for each noisy rollout.
    * @return True if sucessful, otherwise false.
    */
   bool computeRolloutsStateCosts();
 
+  /**
+   * @brief Computes the state costs of a noisy rollout over the optimization window, outside of it the rollout takes
+   * the costs of the optimized parameters.
+   * @param task The task that evaluates the rollout
+   * @param r The rollout number
+   * @param window_costs Workspace for the costs inside the window
+   * @return True if sucessful, otherwise false.
+   */
+  bool computeRolloutStateCosts(Task& task,int r,Eigen::VectorXd& window_costs);
+
+  /**
+   * @brief Computes the cost at every timestep of the rollouts 'w', 'w + num_workers', ... assigned to a worker.
+   * @param w The worker number
+   * @return True if sucessful, otherwise false.
+   */
+  bool computeWorkerRolloutsStateCosts(int w);
+
+  /**
+   * @brief Computes the cost at every timestep for each noisy rollout using the worker threads.
+   * Each worker evaluates a fixed subset of the rollouts so the results do not depend on thread scheduling.
+   * @return True if sucessful, otherwise false.
+   */
+  bool computeRolloutsStateCostsParallel();
+
+  /**
+   * @brief Computes the cost at every timestep of the rollouts 'first_rollout', 'first_rollout + stride', ... with a
+   * single batched call to the task.
+   * @param task The task that evaluates the rollouts
+   * @param first_rollout The first rollout in the batch
+   * @param stride The distance between consecutive rollouts in the batch
+   * @param workspace The buffers used to gather the batch
+   * @return True if sucessful, otherwise false.
+   */
+  bool computeRolloutsStateCostsBatch(Task& task,int first_rollout,int stride,EvaluationWorkspace& workspace);
+
   /**
    * @brief Compute the control cost for each noisy rollout.
    * This is the sum of the acceleration squared, then each
@@ -152,6 +328,16 @@ protected:
    */
   bool computeRolloutsControlCosts();
 
+  /**
+   * @brief Computes the importance weight of the rollouts reused from previous iterations as the ratio of their sampling
+   * density around the current parameters to their density around the parameters they were sampled from.  The noise
+   * of each dimension is modeled as zero mean gaussian with covariance proportional to R^-1, the variance is estimated
+   * from all the rollouts sampled during the optimization.  Only applied when 'reweight_reused_rollouts' is set and
+   * rollouts can be reused.
+   * @return True if sucessful, otherwise false.
+   */
+  bool computeImportanceWeights();
+
   /**
    * @brief Computes the probability from the state cost at every timestep for each noisy rollout.
    * @return True if sucessful, otherwise false.
@@ -164,6 +350,13 @@ protected:
    */
   bool updateParameters();
 
+  /**
+   * @brief Adapts the noise magnitude of each dimension to the probability weighted second moment of the rollouts
+   * noise, a per dimension form of the PI^2-CMA covariance update.  Only applied when 'noise_adaptation_rate' is set.
+   * @return True if sucessful, otherwise false.
+   */
+  bool adaptNoise();
+
   /**
    * @brief Computes the optimized trajectory cost [Control Cost + State Cost]
    * If the current cost is not less than the previous cost the
@@ -179,6 +372,11 @@ protected:
   TaskPtr task_;                                   /**< @brief The task to be optimized. */
   StompConfiguration config_;                      /**< @brief Configuration parameters. */
   unsigned int current_iteration_;                 /**< @brief Current iteration for the optimization. */
+  StompStatistics* statistics_;                    /**< @brief Receives the statistics of the optimization in progress, null when not requested. */
+  std::chrono::steady_clock::time_point deadline_; /**< @brief Time at which the optimization in progress must stop, only used when 'max_solve_time' is set. */
+  std::vector<double> cost_history_;               /**< @brief The optimized cost at the end of each iteration, used to detect convergence */
+  std::shared_ptr<Stomp> coarse_stomp_;            /**< @brief The coarse optimization in progress, kept so that it can be cancelled */
+  std::mutex coarse_stomp_mutex_;                  /**< @brief Guards 'coarse_stomp_' */
 
   // optimized parameters
   bool parameters_valid_;                          /**< @brief whether or not the optimized parameters are valid */
@@ -189,18 +387,61 @@ protected:
   Eigen::VectorXd parameters_state_costs_;         /**< @brief A vector [timesteps] of the parameters state costs */
   Eigen::MatrixXd parameters_control_costs_;       /**< @brief A matrix [dimensions][timesteps] of the parameters control costs*/
 
+  // optimization window
+  int window_start_;                               /**< @brief The first timestep of the optimization window */
+  int window_timesteps_;                           /**< @brief The number of timesteps in the optimization window, the others are kept fixed */
+  bool outside_window_valid_;                      /**< @brief Whether the fixed timesteps outside of the optimization window are valid */
+
+  // best valid solution
+  mutable std::mutex best_solution_mutex_;         /**< @brief Guards the best solution members */
+  bool best_solution_found_;                       /**< @brief Whether a valid solution has been found by the current optimization */
+  Eigen::MatrixXd best_parameters_;                /**< @brief A matrix [dimensions][timesteps] of the lowest cost valid parameters */
+  double best_valid_cost_;                         /**< @brief The cost of 'best_parameters_', tracked apart from 'current_lowest_cost_' which may come from an invalid iterate */
+  int best_iteration_;                             /**< @brief The iteration at which 'best_parameters_' were found */
+
   // rollouts
-  std::vector<Rollout> noisy_rollouts_;            /**< @brief Holds the noisy rollouts */
-  std::vector<Rollout> reused_rollouts_;           /**< @brief Used for reordering arrays based on cost */
+  std::vector<Rollout> noisy_rollouts_;            /**< @brief Holds the storage for the noisy rollouts, accessed through 'rollout_indices_' */
+  std::vector<int> rollout_indices_;               /**< @brief Maps each rollout number to its storage index in 'noisy_rollouts_', reordered in place of copying rollouts */
   int num_active_rollouts_;                        /**< @brief Number of active rollouts */
+  std::vector<std::pair<double,int> > rollout_cost_sorter_; /**< @brief Used to sort the stored rollouts in ascending order wrt their weighted cost */
+  std::vector<int> previous_rollout_indices_;      /**< @brief The 'rollout_indices_' before the reused rollouts are moved */
+  std::vector<bool> kept_rollouts_;                /**< @brief Whether each storage index holds a reused rollout */
+
+  // probability calculation
+  Eigen::MatrixXd rollouts_probabilities_;         /**< @brief A matrix [dimensions x timesteps][rollouts] of the probability for each parameter, column 'r' is laid out as the rollout's [dimensions][timesteps] matrices */
+  Eigen::MatrixXd rollouts_costs_;                 /**< @brief A matrix [dimensions x timesteps][rollouts] of the total cost for each parameter */
+  Eigen::VectorXd rollouts_min_costs_;             /**< @brief A vector [dimensions x timesteps] of the minimum cost among all rollouts */
+  Eigen::VectorXd rollouts_cost_scale_;            /**< @brief A vector [dimensions x timesteps] of per parameter scale factors */
+  Eigen::VectorXd rollouts_weights_;               /**< @brief A vector [rollouts] of the importance weights */
+  Eigen::MatrixXd rollouts_full_costs_;            /**< @brief A matrix [dimensions][rollouts] of the full costs */
+  Eigen::MatrixXd rollouts_noise_energies_;        /**< @brief A matrix [dimensions][rollouts] of noise * R * noise_transpose divided by the noise scale squared */
+  Eigen::VectorXd noise_energies_sum_;             /**< @brief A vector [dimensions] of the sum of the energies of all the rollouts sampled during the optimization */
+  int noise_energies_samples_;                     /**< @brief The number of rollouts added to 'noise_energies_sum_' */
+
+  // noise adaptation
+  Eigen::VectorXd noise_scale_;                    /**< @brief A vector [dimensions] of the factors applied to the noise generated by the task */
+  Eigen::VectorXd sampled_noise_moment_;           /**< @brief A vector [dimensions] of the mean squared noise of the rollouts */
+  Eigen::VectorXd weighted_noise_moment_;          /**< @brief A vector [dimensions] of the probability weighted squared noise of the rollouts */
+
+  // parallel evaluation
+  std::vector<TaskPtr> worker_tasks_;              /**< @brief The tasks used by each worker thread, empty when evaluating serially, kept across optimizations */
+  std::vector<EvaluationWorkspace> workspaces_;    /**< @brief The evaluation buffers of each worker, the first one is also used by the serial evaluation */
+  std::vector<std::thread> worker_threads_;        /**< @brief The worker threads, started on the first parallel evaluation of an optimization */
+  std::vector<char> workers_success_;              /**< @brief Whether each worker evaluated its rollouts successfully */
+  std::mutex workers_mutex_;                       /**< @brief Guards the worker signaling members */
+  std::condition_variable workers_start_cv_;       /**< @brief Signals the workers that a new set of rollouts is ready */
+  std::condition_variable workers_done_cv_;        /**< @brief Signals the optimization thread that a worker finished */
+  int workers_generation_;                         /**< @brief Incremented for every set of rollouts handed to the workers */
+  int workers_pending_;                            /**< @brief The number of workers still evaluating the current set of rollouts */
+  bool workers_exit_;                              /**< @brief Tells the workers to return */
 
   // finite difference and optimization matrices
   int num_timesteps_padded_;                       /**< @brief The number of timesteps to pad the optimization with: timesteps + 2*(FINITE_DIFF_RULE_LENGTH - 1) */
   int start_index_padded_;                         /**< @brief The index corresponding to the start of the non-paded section in the padded arrays */
-  Eigen::MatrixXd finite_diff_matrix_A_padded_;    /**< @brief The finite difference matrix including padding */
-  Eigen::MatrixXd control_cost_matrix_R_padded_;   /**< @brief The control cost matrix including padding */
-  Eigen::MatrixXd control_cost_matrix_R_;          /**< @brief A matrix [timesteps][timesteps], Referred to as 'R = A x A_transpose' in the literature */
-  Eigen::MatrixXd inv_control_cost_matrix_R_;      /**< @brief A matrix [timesteps][timesteps], R^-1 ' matrix */
+  ControlCostMatricesConstPtr control_cost_matrices_;       /**< @brief The finite difference and control cost matrices, shared through the process wide cache */
+
+  // computations over the dimensions
+  StompKernelTable kernels_;                                 /**< @brief The StompKernels specialization for the number of dimensions */
 
 
 };
@@ -0,0 +1,138 @@
+/**
+ * @file stomp_kernels.h
+ * @brief This contains the stomp computations over the dimensions specialized for a fixed number of dimensions
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_STOMP_KERNELS_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_STOMP_KERNELS_H_
+
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+#include "stomp_core/utils.h"
+
+namespace stomp_core
+{
+
+/**
+ * @brief The stomp computations that operate on every dimension of a [dimensions][timesteps] matrix.  When DOF is
+ * fixed the columns are held in fixed size vectors so that the loops over the dimensions are unrolled and need no
+ * heap storage, Eigen::Dynamic is the fallback for any number of dimensions.  The matrices passed in must have DOF
+ * rows.
+ */
+template <int DOF>
+struct StompKernels
+{
+  typedef Eigen::Matrix<double,DOF,Eigen::Dynamic> Parameters;  /**< @brief A matrix [dimensions][timesteps] */
+  typedef Eigen::Matrix<double,DOF,1> DimensionVector;          /**< @brief A vector [dimensions] */
+
+  /**
+   * @brief Computes the quadratic form x.row(d) * R * x.row(d)_transpose for every dimension
+   * @param x         A matrix [dimensions][timesteps]
+   * @param R         A symmetric matrix [timesteps][timesteps]
+   * @param costs     Receives the [dimensions] quadratic costs
+   */
+  static void computeQuadraticCosts(const Eigen::MatrixXd& x,const Eigen::SparseMatrix<double>& R,double* costs)
+  {
+    Eigen::Map<const Parameters> p(x.data(),x.rows(),x.cols());
+    Eigen::Map<DimensionVector> c(costs,x.rows());
+    c.setZero();
+    for(int k = 0; k < R.outerSize(); k++)
+    {
+      for(Eigen::SparseMatrix<double>::InnerIterator it(R,k); it; ++it)
+      {
+        c += it.value()*p.col(it.row()).cwiseProduct(p.col(k));
+      }
+    }
+  }
+
+  /**
+   * @brief Computes the control costs of the parameters, every dimension takes its normalized cost at all timesteps
+   * @param parameters            A matrix [dimensions][timesteps]
+   * @param dt                    The timestep in seconds
+   * @param control_cost_weight   The control cost weight
+   * @param control_cost_matrix_R The control cost matrix
+   * @param control_costs         Receives the [dimensions][timesteps] control costs
+   */
+  static void computeControlCosts(const Eigen::MatrixXd& parameters,double dt,double control_cost_weight,
+                                  const Eigen::SparseMatrix<double>& control_cost_matrix_R,
+                                  Eigen::MatrixXd& control_costs)
+  {
+    // the first column holds the costs of each dimension until they are copied to the other timesteps
+    Eigen::Map<Parameters> c(control_costs.data(),control_costs.rows(),control_costs.cols());
+    computeQuadraticCosts(parameters,control_cost_matrix_R,control_costs.data());
+    c.col(0) *= 0.5*(1/dt);
+
+    double max_coeff = c.col(0).maxCoeff();
+    c.col(0) *= control_cost_weight/((max_coeff > 1e-8) ? max_coeff : 1);
+
+    for(int t = 1; t < c.cols(); t++)
+    {
+      c.col(t) = c.col(0);
+    }
+  }
+
+  /**
+   * @brief Combines the state and control costs of a rollout into its total costs
+   * @param rollout The rollout whose full_costs, total_cost and total_costs are computed
+   */
+  static void computeTotalCosts(Rollout& rollout)
+  {
+    Eigen::Map<const Parameters> control_costs(rollout.control_costs.data(),rollout.control_costs.rows(),
+                                               rollout.control_costs.cols());
+    Eigen::Map<Parameters> total_costs(rollout.total_costs.data(),rollout.total_costs.rows(),
+                                       rollout.total_costs.cols());
+    Eigen::Map<DimensionVector> full_costs(rollout.full_costs.data(),rollout.full_costs.size());
+
+    double total_state_cost = rollout.state_costs.sum();
+    full_costs = control_costs.rowwise().sum();
+    rollout.total_cost = total_state_cost + full_costs.sum();
+    full_costs.array() += total_state_cost;
+
+    total_costs = control_costs.rowwise() + rollout.state_costs.transpose();
+  }
+};
+
+/** @brief The entry points of a StompKernels specialization, so that one can be selected at runtime */
+struct StompKernelTable
+{
+  void (*computeQuadraticCosts)(const Eigen::MatrixXd&,const Eigen::SparseMatrix<double>&,double*);  /**< @brief See StompKernels::computeQuadraticCosts */
+  void (*computeControlCosts)(const Eigen::MatrixXd&,double,double,const Eigen::SparseMatrix<double>&,
+                              Eigen::MatrixXd&);                                                      /**< @brief See StompKernels::computeControlCosts */
+  void (*computeTotalCosts)(Rollout&);                                                                /**< @brief See StompKernels::computeTotalCosts */
+
+  /**
+   * @brief Creates the table of a specialization
+   * @return The entry points of StompKernels<DOF>
+   */
+  template <int DOF>
+  static StompKernelTable create()
+  {
+    return StompKernelTable{&StompKernels<DOF>::computeQuadraticCosts,
+                            &StompKernels<DOF>::computeControlCosts,
+                            &StompKernels<DOF>::computeTotalCosts};
+  }
+};
+
+}
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_STOMP_KERNELS_H_ */
@@ -0,0 +1,85 @@
+/**
+ * @file stomp_portfolio.h
+ * @brief This contains a solver that runs several stomp optimizations in parallel
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_STOMP_PORTFOLIO_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_STOMP_PORTFOLIO_H_
+
+#include <memory>
+#include <mutex>
+#include "stomp_core/stomp.h"
+
+namespace stomp_core
+{
+
+/**
+ * @brief Runs independent Stomp instances on separate threads and keeps the first valid solution, the remaining
+ * instances are then cancelled.  When none of them finds a valid solution the lowest cost one is returned.  Each
+ * instance should be given its own task with a differently seeded noise generator, the configurations may also
+ * differ, e.g. in the initialization method.
+ */
+class StompPortfolio
+{
+public:
+  /**
+   * @brief StompPortfolio Constructor
+   * @param configs The configuration of each instance
+   * @param tasks The task optimized by each instance, a task must not be shared among instances unless it is thread-safe
+   */
+  StompPortfolio(const std::vector<StompConfiguration>& configs,const std::vector<TaskPtr>& tasks);
+
+  /**
+   * @brief Find the optimal solution provided a start and end goal.
+   * @param first Start state for the task
+   * @param last Final state for the task
+   * @param parameters_optimized Optimized solution [parameters][timesteps]
+   * @param instance The index of the instance that produced the solution, -1 when all of them failed
+   * @return True if a valid solution was found, otherwise false.
+   */
+  bool solve(const std::vector<double>& first,const std::vector<double>& last,
+             Eigen::MatrixXd& parameters_optimized,int& instance);
+
+  /**
+   * @brief Cancel all the optimizations in progress. (Thread-Safe)  When no solve is in progress the next one is
+   * cancelled instead.
+   * @return True if sucessful, otherwise false.
+   */
+  bool cancel();
+
+  /**
+   * @brief The number of Stomp instances
+   * @return The number of instances
+   */
+  std::size_t size() const;
+
+protected:
+
+  std::vector<std::shared_ptr<Stomp> > instances_;   /**< @brief The Stomp instances */
+  std::mutex result_mutex_;                          /**< @brief Guards the selection of the solution and the cancellation */
+  bool cancelled_ = false;                           /**< @brief Whether cancel() was called since the last solve finished */
+};
+
+} /* namespace stomp_core */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_STOMP_PORTFOLIO_H_ */
@@ -28,6 +28,7 @@
 
 #include <XmlRpcValue.h>
 #include <boost/shared_ptr.hpp>
+#include <vector>
 #include <Eigen/Core>
 #include "stomp_core/utils.h"
 
@@ -45,6 +46,53 @@ public:
 
     Task(){}
 
+    virtual ~Task(){}
+
+    /**
+     * @brief Whether the cost methods of this task can be called concurrently from multiple threads.
+     * When true, Stomp shares this instance among all of its worker threads.
+     * @return True if computeNoisyCosts is thread-safe, otherwise false
+     */
+    virtual bool isThreadSafe() const
+    {
+      return false;
+    }
+
+    /**
+     * @brief Creates a copy of this task that will be used exclusively by a single worker thread.  The copies are
+     * kept by Stomp across optimizations, see updateClone.
+     * @return A new task or an empty pointer if cloning is not supported
+     */
+    virtual TaskPtr clone() const
+    {
+      return TaskPtr();
+    }
+
+    /**
+     * @brief Brings a copy created by clone up to date with the current state of this task.  This method is called
+     * at the start of each optimization for every kept copy, it should skip the work when nothing has changed since
+     * the last call.
+     * @param clone A task previously returned by clone
+     * @return True if the copy can be used, false otherwise
+     */
+    virtual bool updateClone(Task& clone) const
+    {
+      return true;
+    }
+
+    /**
+     * @brief Prepares the task to evaluate parameters with a different number of timesteps.  This is called by the
+     * coarse to fine optimization before and after the coarse optimization, the total duration of the trajectory is
+     * preserved so the time interval changes accordingly.  The coarse optimization also notifies the task through
+     * postIteration and done.
+     * @param num_timesteps     The number of timesteps of the parameters to be evaluated next
+     * @return False if the task can only evaluate the number of timesteps it was set up with, otherwise true
+     */
+    virtual bool setNumTimesteps(int num_timesteps)
+    {
+      return false;
+    }
+
     /**
      * @brief Generates a noisy trajectory from the parameters.
      * @param parameters        A matrix [num_dimensions][num_parameters] of the current optimized parameters
@@ -83,6 +131,51 @@ public:
                          Eigen::VectorXd& costs,
                          bool& validity) = 0 ;
 
+    /**
+     * @brief Whether this task overrides computeNoisyCostsBatch.  When true, Stomp hands all the new rollouts of an
+     * iteration to a single computeNoisyCostsBatch call (or one call per worker thread) instead of calling
+     * computeNoisyCosts for each rollout.
+     * @return True if computeNoisyCostsBatch is implemented by the task, otherwise false
+     */
+    virtual bool hasBatchCosts() const
+    {
+      return false;
+    }
+
+    /**
+     * @brief computes the state costs of several noisy rollouts at once, allowing the task to share work among them.  The
+     * default implementation calls computeNoisyCosts for each rollout.
+     * @param parameters        The noisy parameters [num_dimensions][num_parameters] of each rollout in the batch
+     * @param start_timestep    The start index into the 'parameters' array, usually 0.
+     * @param num_timesteps     The number of elements to use from 'parameters' starting from 'start_timestep'
+     * @param iteration_number  The current iteration count in the optimization loop
+     * @param rollout_numbers   The index of each noisy trajectory in the batch.
+     * @param costs             Receives the vector of state costs per timestep of each rollout in the batch.
+     * @param validity          Whether or not all the trajectories are valid
+     * @return True if cost were properly computed, otherwise false
+     */
+    virtual bool computeNoisyCostsBatch(const std::vector<const Eigen::MatrixXd*>& parameters,
+                                        std::size_t start_timestep,
+                                        std::size_t num_timesteps,
+                                        int iteration_number,
+                                        const std::vector<int>& rollout_numbers,
+                                        const std::vector<Eigen::VectorXd*>& costs,
+                                        bool& validity)
+    {
+      validity = true;
+      bool rollout_valid;
+      for(auto i = 0u; i < parameters.size(); i++)
+      {
+        if(!computeNoisyCosts(*parameters[i],start_timestep,num_timesteps,iteration_number,rollout_numbers[i],
+                              *costs[i],rollout_valid))
+        {
+          return false;
+        }
+        validity &= rollout_valid;
+      }
+      return true;
+    }
+
     /**
      * @brief computes the state costs as a function of the optimized parameters for each time step.
      * @param parameters        A matrix [num_dimensions][num_parameters] of the policy parameters to execute
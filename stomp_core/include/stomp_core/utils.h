@@ -27,8 +27,10 @@
 #define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_STOMP_UTILS_H_
 
 #include <string>
+#include <limits>
 #include <vector>
 #include <Eigen/Core>
+#include <Eigen/Sparse>
 
 namespace stomp_core
 {
@@ -42,13 +44,14 @@ struct Rollout
   Eigen::VectorXd state_costs;             /**< @brief A vector [num_time_steps] of the cost at each timestep */
   Eigen::MatrixXd control_costs;           /**< @brief A matrix [num_dimensions][num_time_steps] of the control cost for each parameter at every timestep */
   Eigen::MatrixXd total_costs;             /**< @brief A matrix [num_dimensions][num_time_steps] of the total cost, where total_cost[d] = state_costs_ + control_costs_[d]*/
-  Eigen::MatrixXd probabilities;           /**< @brief A matrix [num_dimensions][num_time_steps] of the probability for each parameter at every timestep */
 
   std::vector<double> full_probabilities; /**< @brief A vector [num_dimensions] of the probabilities for the full trajectory */
   std::vector<double> full_costs;         /**< @brief A vector [num_dimensions] of the full coss, state_cost + control_cost for each joint over the entire trajectory
                                                full_costs_[d] = state_cost.sum() + control_cost[d].sum() */
 
   double importance_weight;               /**< @brief importance sampling weight */
+  Eigen::VectorXd sampling_energies;      /**< @brief A vector [num_dimensions] of noise * R * noise_transpose when the rollout was sampled, divided by the noise scale squared */
+  Eigen::VectorXd sampling_scales;        /**< @brief A vector [num_dimensions] of the noise scale the rollout was sampled with */
   double total_cost;                      /**< @brief combined state + control cost over the entire trajectory for all joints */
 
 };
@@ -94,9 +97,48 @@ struct StompConfiguration
   // Noisy trajectory generation
   int num_rollouts;                      /**< @brief Number of noisy trajectories*/
   int max_rollouts;                      /**< @brief The combined number of new and old rollouts during each iteration shouldn't exceed this value */
+  bool reweight_reused_rollouts = false; /**< @brief Weights the reused rollouts by their sampling density ratio instead of 1 */
 
   // Cost calculation
   double control_cost_weight;            /**< @brief Percentage of the trajectory accelerations cost to be applied in the total cost calculation >*/
+
+  // Parallel evaluation
+  int num_threads = 1;                   /**< @brief Number of threads used to compute the rollouts state costs, values less than 2 run serially */
+
+  // Termination criteria
+  int convergence_iterations = 0;        /**< @brief Number of iterations over which the relative cost improvement is measured, 0 disables this criterion */
+  double convergence_threshold = 0.0;    /**< @brief Stomp stops when the cost improved by less than this fraction over the last 'convergence_iterations' */
+  double cost_target = std::numeric_limits<double>::lowest(); /**< @brief Stomp stops as soon as the optimized cost is at or below this value */
+  double max_solve_time = 0.0;           /**< @brief Wall time in seconds after which the optimization stops, 0 disables this criterion */
+
+  // Noise adaptation
+  double noise_adaptation_rate = 0.0;    /**< @brief Rate in [0, 1] at which the noise magnitude of each dimension follows the probability weighted spread of the rollouts, 0 disables it */
+  double min_noise_scale = 0.1;          /**< @brief Lower bound of the factor applied to the noise generated by the task */
+  double max_noise_scale = 10.0;         /**< @brief Upper bound of the factor applied to the noise generated by the task */
+
+  // Coarse to fine optimization
+  int num_coarse_timesteps = 0;          /**< @brief Number of timesteps of the coarse optimization that seeds the full resolution one, 0 disables it */
+  int num_coarse_iterations = 0;         /**< @brief Maximum number of iterations of the coarse optimization, 0 uses 'num_iterations' */
+};
+
+/** @brief The data structure used to report the time spent in each optimization phase along with other statistics. */
+struct StompStatistics
+{
+  // wall time in seconds spent in each phase, accumulated over all iterations
+  double noise_generation_time = 0;      /**< @brief Time spent generating the noisy rollouts */
+  double noisy_filters_time = 0;         /**< @brief Time spent applying the noisy filters to the rollouts */
+  double state_costs_time = 0;           /**< @brief Time spent computing the state costs of the noisy rollouts */
+  double control_costs_time = 0;         /**< @brief Time spent computing the control costs of the noisy rollouts */
+  double probabilities_time = 0;         /**< @brief Time spent computing the rollout probabilities */
+  double update_filters_time = 0;        /**< @brief Time spent computing and filtering the parameter updates */
+  double optimized_cost_time = 0;        /**< @brief Time spent computing the cost of the optimized parameters */
+  double total_time = 0;                 /**< @brief Total time spent in the optimization */
+
+  std::vector<double> cost_history;      /**< @brief A vector [iterations] of the optimized parameters cost at the end of each iteration */
+  int iterations = 0;                    /**< @brief Number of iterations completed */
+  int rollouts_evaluated = 0;            /**< @brief Number of new noisy rollouts whose state costs were computed */
+  int rollouts_reused = 0;               /**< @brief Number of rollouts carried over from a previous iteration */
+  int threads = 1;                       /**< @brief Number of threads that computed the rollouts state costs, 1 when the task could not be evaluated in parallel */
 };
 
 /** @brief The number of columns in the finite differentiation rule */
@@ -129,8 +171,20 @@ void generateFiniteDifferenceMatrix(int num_time_steps, DerivativeOrders::Deriva
                                     Eigen::MatrixXd& diff_matrix);
 
 /**
- * @brief Differentiates the input parameters based on the DerivativeOrder.
- * @param parameters  The parameters to be differentiated
+ * @brief Generate a sparse finite difference matrix based on the input DerivativeOrder.  Only the
+ * FINITE_DIFF_RULE_LENGTH wide band around the diagonal is stored so that memory grows linearly with the number of timesteps.
+ * @param num_time_steps The number of timesteps
+ * @param order          The differentiation order
+ * @param dt             The timestep in seconds
+ * @param diff_matrix    The generated finite difference matrix
+ */
+void generateFiniteDifferenceMatrix(int num_time_steps, DerivativeOrders::DerivativeOrder order, double dt,
+                                    Eigen::SparseMatrix<double>& diff_matrix);
+
+/**
+ * @brief Differentiates the input parameters based on the DerivativeOrder.  The finite difference rules are applied
+ * as stencils at each timestep, the forward and backward rules at the ends, so this runs in linear time.
+ * @param parameters  The parameters to be differentiated, at least FINITE_DIFF_RULE_LENGTH of them
  * @param order       The differentiation order
  * @param dt          The timestep in seconds
  * @param derivatives The differentiation of the input parameters
@@ -138,6 +192,34 @@ void generateFiniteDifferenceMatrix(int num_time_steps, DerivativeOrders::Deriva
 void differentiate(const Eigen::VectorXd& parameters, DerivativeOrders::DerivativeOrder order,
                           double dt, Eigen::VectorXd& derivatives );
 
+/**
+ * @brief Same as differentiate but builds the dense difference matrix, kept to verify the stencil version.
+ * @param parameters  The parameters to be differentiated, at least FINITE_DIFF_RULE_LENGTH of them
+ * @param order       The differentiation order
+ * @param dt          The timestep in seconds
+ * @param derivatives The differentiation of the input parameters
+ */
+void differentiateDense(const Eigen::VectorXd& parameters, DerivativeOrders::DerivativeOrder order,
+                        double dt, Eigen::VectorXd& derivatives);
+
+/**
+ * @brief Computes the control cost 'x.row(d) * R * x.row(d)_transpose' of each dimension, where R = dt*A_transpose*A
+ * is the control cost matrix before Stomp normalizes it and A the acceleration finite difference matrix.  The
+ * acceleration stencil is applied to the parameters padded with zeros, so this runs in linear time.
+ * @param parameters  A matrix [dimensions][timesteps]
+ * @param dt          The timestep in seconds
+ * @param costs       The returned vector [dimensions] of control costs
+ */
+void computeControlCosts(const Eigen::MatrixXd& parameters, double dt, Eigen::VectorXd& costs);
+
+/**
+ * @brief Same as computeControlCosts but builds the dense control cost matrix, kept to verify the stencil version.
+ * @param parameters  A matrix [dimensions][timesteps]
+ * @param dt          The timestep in seconds
+ * @param costs       The returned vector [dimensions] of control costs
+ */
+void computeControlCostsDense(const Eigen::MatrixXd& parameters, double dt, Eigen::VectorXd& costs);
+
 /**
  * @brief Generate a smoothing matrix M
  * @param num_time_steps       The number of timesteps
@@ -146,6 +228,15 @@ void differentiate(const Eigen::VectorXd& parameters, DerivativeOrders::Derivati
  */
 void generateSmoothingMatrix(int num_time_steps, double dt, Eigen::MatrixXd& projection_matrix_M);
 
+/**
+ * @brief Resamples the parameters to a different number of timesteps using piecewise cubic Hermite interpolation.
+ * The tangents are estimated from finite differences and the first and last timesteps are preserved exactly.
+ * @param parameters     A matrix [dimensions][timesteps] of the parameters to be resampled, at least two timesteps
+ * @param num_timesteps  The number of timesteps of the resampled parameters
+ * @param resampled      The returned matrix [dimensions][num_timesteps]
+ */
+void resampleParameters(const Eigen::MatrixXd& parameters, int num_timesteps, Eigen::MatrixXd& resampled);
+
 /**
  * @brief Convert a Eigen::MatrixXd to a std::vector<Eigen::VectorXd>
  * Each element in the std::vector represents a row in the Eigen::MatrixXd
@@ -169,6 +260,13 @@ std::string toString(const std::vector<Eigen::VectorXd>& data);
  */
 std::string toString(const Eigen::VectorXd& data);
 
+/**
+ * @brief Convert a StompStatistics structure to a formated string
+ * @param statistics The item to be converted
+ * @return Formated string representing the statistics
+ */
+std::string toString(const StompStatistics& statistics);
+
 /**
  * @brief Convert an Eigen::MatrixXd to a formated string
  * @param data The item to be converted
@@ -0,0 +1,338 @@
+/**
+ * @file matrix_cache.cpp
+ * @brief This contains a process wide cache of the matrices that only depend on the trajectory discretization
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include "stomp_core/matrix_cache.h"
+
+/**
+ * @brief Computes the largest diagonal entry of R^-1 without forming the inverse.  The entries of R^-1 within
+ * the band of R are obtained from its LDL^T factorization through the Takahashi recurrence:
+ * Z(i,j) = delta(i,j)/D(i) - sum_k L(k,i)*Z(k,j), for k in (i,i + bandwidth]
+ * @param ldlt      The factorization of R
+ * @param bandwidth The number of non-zero sub-diagonals in R
+ * @return The largest diagonal entry of R^-1
+ */
+static double computeMaxInverseDiagonal(const stomp_core::ControlCostMatrixLDLT& ldlt,int bandwidth)
+{
+  const Eigen::SparseMatrix<double>& L = ldlt.matrixL().nestedExpression();
+  const Eigen::VectorXd D = ldlt.vectorD();
+  int n = D.size();
+
+  // banded storage, Z_band(i,o) = Z(i,i+o)
+  Eigen::MatrixXd Z_band = Eigen::MatrixXd::Zero(n,bandwidth + 1);
+  auto Z = [&Z_band](int i,int j) -> double
+  {
+    return i < j ? Z_band(i,j - i) : Z_band(j,i - j);
+  };
+
+  double max_coeff = -std::numeric_limits<double>::max();
+  for(int i = n - 1; i >= 0; i--)
+  {
+    for(int j = std::min(n - 1,i + bandwidth); j >= i; j--)
+    {
+      double z = (i == j) ? 1.0/D(i) : 0.0;
+      for(Eigen::SparseMatrix<double>::InnerIterator it(L,i); it; ++it)
+      {
+        if(it.row() > i)
+        {
+          z -= it.value()*Z(it.row(),j);
+        }
+      }
+      Z_band(i,j - i) = z;
+    }
+
+    max_coeff = std::max(max_coeff,Z_band(i,0));
+  }
+
+  return max_coeff;
+}
+
+namespace stomp_core
+{
+
+/** @brief Identifies a cached matrix */
+struct MatrixKey
+{
+  std::string name;                          /**< @brief The name of the matrix */
+  int num_timesteps;                         /**< @brief The number of timesteps */
+  double dt;                                 /**< @brief The timestep in seconds */
+  int order;                                 /**< @brief The derivative order */
+
+  bool operator<(const MatrixKey& other) const
+  {
+    return std::tie(name,num_timesteps,dt,order) < std::tie(other.name,other.num_timesteps,other.dt,other.order);
+  }
+};
+
+static const std::size_t DEFAULT_MATRIX_CACHE_CAPACITY = 32; /**< Default maximum number of cached matrices */
+
+/** @brief A cached value along with the time it was last requested */
+template <typename T>
+struct CacheEntry
+{
+  std::shared_ptr<const T> value;            /**< @brief The cached value */
+  unsigned long last_use;                    /**< @brief The value of the cache use counter when last requested */
+};
+
+/** @brief The process wide cache, the least recently used entries are evicted beyond its capacity */
+struct MatrixCache
+{
+  std::mutex mutex;                                                        /**< @brief Guards the members */
+  std::map<MatrixKey,CacheEntry<Eigen::MatrixXd> > matrices;               /**< @brief The dense matrices */
+  std::map<MatrixKey,CacheEntry<ControlCostMatrices> > control_costs;      /**< @brief The control cost matrices */
+  unsigned long use_counter = 0;                                           /**< @brief Incremented on every request */
+  std::size_t capacity = DEFAULT_MATRIX_CACHE_CAPACITY;                    /**< @brief The maximum number of entries */
+};
+
+/**
+ * @brief Gets the process wide cache, constructed on first use so that it can be used during static initialization
+ * @return The cache
+ */
+static MatrixCache& getMatrixCache()
+{
+  static MatrixCache cache;
+  return cache;
+}
+
+/**
+ * @brief Finds the least recently used entry of a map of the cache
+ * @param entries The map of the cache
+ * @return The least recently used entry, the end of the map when it is empty
+ */
+template <typename T>
+static typename std::map<MatrixKey,CacheEntry<T> >::iterator findLeastRecentlyUsed(
+    std::map<MatrixKey,CacheEntry<T> >& entries)
+{
+  auto oldest = entries.begin();
+  for(auto entry = entries.begin(); entry != entries.end(); entry++)
+  {
+    if(entry->second.last_use < oldest->second.last_use)
+    {
+      oldest = entry;
+    }
+  }
+  return oldest;
+}
+
+/**
+ * @brief Removes the least recently used entries until the cache is within its capacity, the caller must hold the lock
+ * @param cache The cache
+ */
+static void evictMatrices(MatrixCache& cache)
+{
+  while(cache.matrices.size() + cache.control_costs.size() > cache.capacity)
+  {
+    auto oldest_matrix = findLeastRecentlyUsed(cache.matrices);
+    auto oldest_control_costs = findLeastRecentlyUsed(cache.control_costs);
+    if(oldest_control_costs == cache.control_costs.end() ||
+        (oldest_matrix != cache.matrices.end() &&
+         oldest_matrix->second.last_use < oldest_control_costs->second.last_use))
+    {
+      cache.matrices.erase(oldest_matrix);
+    }
+    else
+    {
+      cache.control_costs.erase(oldest_control_costs);
+    }
+  }
+}
+
+/**
+ * @brief Looks up an entry and marks it as the most recently used, the caller must hold the lock
+ * @param cache   The cache
+ * @param entries The map of the cache to search
+ * @param key     The key of the entry
+ * @return The cached value, null when it is not cached
+ */
+template <typename T>
+static std::shared_ptr<const T> findEntry(MatrixCache& cache,std::map<MatrixKey,CacheEntry<T> >& entries,
+                                          const MatrixKey& key)
+{
+  auto entry = entries.find(key);
+  if(entry == entries.end())
+  {
+    return nullptr;
+  }
+
+  entry->second.last_use = ++cache.use_counter;
+  return entry->second.value;
+}
+
+/**
+ * @brief Stores an entry unless another caller stored it first and evicts beyond the capacity, the caller must hold
+ * the lock
+ * @param cache   The cache
+ * @param entries The map of the cache to insert into
+ * @param key     The key of the entry
+ * @param value   The value to store
+ * @return The cached value, the one stored first when the key is already present
+ */
+template <typename T>
+static std::shared_ptr<const T> insertEntry(MatrixCache& cache,std::map<MatrixKey,CacheEntry<T> >& entries,
+                                            const MatrixKey& key,const std::shared_ptr<const T>& value)
+{
+  CacheEntry<T>& entry = entries.emplace(key,CacheEntry<T>{value,0}).first->second;
+  entry.last_use = ++cache.use_counter;
+  std::shared_ptr<const T> cached = entry.value;
+  evictMatrices(cache);
+  return cached;
+}
+
+/**
+ * @brief Generates the control cost matrices
+ * @param num_timesteps The number of timesteps
+ * @param dt            The timestep in seconds
+ * @return The control cost matrices, unscaled when the factorization failed
+ */
+static std::shared_ptr<ControlCostMatrices> generateControlCostMatrices(int num_timesteps,double dt)
+{
+  std::shared_ptr<ControlCostMatrices> m = std::make_shared<ControlCostMatrices>();
+
+  // generate finite difference matrix
+  int start_index_padded = FINITE_DIFF_RULE_LENGTH-1;
+  int num_timesteps_padded = num_timesteps + 2*(FINITE_DIFF_RULE_LENGTH-1);
+  generateFiniteDifferenceMatrix(num_timesteps_padded,DerivativeOrders::STOMP_ACCELERATION,
+                                 dt,m->finite_diff_matrix_A_padded);
+
+  /* control cost matrix (R = A_transpose * A):
+   * Note: Original code multiplies the A product by the time interval.  However this is not
+   * what was described in the literature
+   */
+  m->control_cost_matrix_R_padded = dt*m->finite_diff_matrix_A_padded.transpose() * m->finite_diff_matrix_A_padded;
+
+  std::vector<Eigen::Triplet<double> > coefficients;
+  for(int k = 0; k < m->control_cost_matrix_R_padded.outerSize(); k++)
+  {
+    for(Eigen::SparseMatrix<double>::InnerIterator it(m->control_cost_matrix_R_padded,k); it; ++it)
+    {
+      int row = it.row() - start_index_padded;
+      int col = it.col() - start_index_padded;
+      if(row >= 0 && row < num_timesteps && col >= 0 && col < num_timesteps)
+      {
+        coefficients.push_back(Eigen::Triplet<double>(row,col,it.value()));
+      }
+    }
+  }
+  m->control_cost_matrix_R.resize(num_timesteps,num_timesteps);
+  m->control_cost_matrix_R.setFromTriplets(coefficients.begin(),coefficients.end());
+  m->control_cost_matrix_R_ldlt.compute(m->control_cost_matrix_R);
+  if(m->control_cost_matrix_R_ldlt.info() != Eigen::Success)
+  {
+    return m;
+  }
+
+  /*
+   * Applying scale factor to ensure that max(R^-1)==1
+   */
+  double maxVal = std::abs(computeMaxInverseDiagonal(m->control_cost_matrix_R_ldlt,2*(FINITE_DIFF_RULE_LENGTH/2)));
+  m->control_cost_matrix_R_padded *= maxVal;
+  m->control_cost_matrix_R *= maxVal;
+  m->control_cost_matrix_R_ldlt.compute(m->control_cost_matrix_R); // used in computing the minimum control cost initial trajectory
+
+  return m;
+}
+
+ControlCostMatricesConstPtr getControlCostMatrices(int num_timesteps,double dt)
+{
+  MatrixCache& cache = getMatrixCache();
+  MatrixKey key{"control_cost",num_timesteps,dt,DerivativeOrders::STOMP_ACCELERATION};
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    ControlCostMatricesConstPtr cached = findEntry(cache,cache.control_costs,key);
+    if(cached)
+    {
+      return cached;
+    }
+  }
+
+  ControlCostMatricesConstPtr matrices = generateControlCostMatrices(num_timesteps,dt);
+  if(matrices->control_cost_matrix_R_ldlt.info() != Eigen::Success)
+  {
+    return matrices;
+  }
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  return insertEntry(cache,cache.control_costs,key,matrices);
+}
+
+MatrixConstPtr getSmoothingMatrix(int num_timesteps,double dt)
+{
+  return getCachedMatrix("smoothing",num_timesteps,dt,DerivativeOrders::STOMP_ACCELERATION,
+                         [num_timesteps,dt](Eigen::MatrixXd& m)
+  {
+    generateSmoothingMatrix(num_timesteps,dt,m);
+  });
+}
+
+MatrixConstPtr getCachedMatrix(const std::string& name,int num_timesteps,double dt,
+                               DerivativeOrders::DerivativeOrder order,
+                               const std::function<void (Eigen::MatrixXd&)>& generate)
+{
+  MatrixCache& cache = getMatrixCache();
+  MatrixKey key{name,num_timesteps,dt,order};
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    MatrixConstPtr cached = findEntry(cache,cache.matrices,key);
+    if(cached)
+    {
+      return cached;
+    }
+  }
+
+  // generating without the lock so that other matrices can be retrieved meanwhile
+  std::shared_ptr<Eigen::MatrixXd> matrix = std::make_shared<Eigen::MatrixXd>();
+  generate(*matrix);
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  return insertEntry<Eigen::MatrixXd>(cache,cache.matrices,key,matrix);
+}
+
+void clearMatrixCache()
+{
+  MatrixCache& cache = getMatrixCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.matrices.clear();
+  cache.control_costs.clear();
+}
+
+void setMatrixCacheCapacity(std::size_t capacity)
+{
+  MatrixCache& cache = getMatrixCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.capacity = capacity;
+  evictMatrices(cache);
+}
+
+std::size_t getMatrixCacheSize()
+{
+  MatrixCache& cache = getMatrixCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  return cache.matrices.size() + cache.control_costs.size();
+}
+
+}
@@ -0,0 +1,68 @@
+/**
+ * @file random_stream.cpp
+ * @brief This contains a counter based random number generator that yields reproducible independent streams
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include "stomp_core/random_stream.h"
+
+namespace stomp_core
+{
+
+const std::uint64_t RandomStream::GOLDEN_GAMMA;
+
+RandomStream::RandomStream(std::uint64_t seed,int iteration,int rollout,int dimension)
+{
+  reset(seed,iteration,rollout,dimension);
+}
+
+void RandomStream::reset(std::uint64_t seed,int iteration,int rollout,int dimension)
+{
+  // chaining the hash over the indices, negative indices (e.g. -1 for the noiseless rollout) are valid
+  key_ = mix(seed + GOLDEN_GAMMA);
+  key_ = mix(key_ ^ (static_cast<std::uint32_t>(iteration) + GOLDEN_GAMMA));
+  key_ = mix(key_ ^ (static_cast<std::uint32_t>(rollout) + GOLDEN_GAMMA));
+  key_ = mix(key_ ^ (static_cast<std::uint32_t>(dimension) + GOLDEN_GAMMA));
+  counter_ = 0;
+  has_spare_normal_ = false;
+  spare_normal_ = 0;
+}
+
+double RandomStream::nextNormal()
+{
+  if(has_spare_normal_)
+  {
+    has_spare_normal_ = false;
+    return spare_normal_;
+  }
+
+  // 1 - u is in (0, 1] so that the log is finite
+  double radius = std::sqrt(-2.0*std::log(1.0 - nextUniform()));
+  double angle = 2.0*M_PI*nextUniform();
+  spare_normal_ = radius*std::sin(angle);
+  has_spare_normal_ = true;
+  return radius*std::cos(angle);
+}
+
+}
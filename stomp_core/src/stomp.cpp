@@ -31,11 +31,16 @@
 #include <math.h>
 #include <stomp_core/utils.h>
 #include <numeric>
+#include <algorithm>
+#include <thread>
+#include <chrono>
 #include "stomp_core/stomp.h"
 
 static const double DEFAULT_NOISY_COST_IMPORTANCE_WEIGHT = 1.0; /**< Default noisy cost importance weight */
 static const double MIN_COST_DIFFERENCE = 1e-8; /**< Minimum cost difference allowed during probability calculation */
 static const double MIN_CONTROL_COST_WEIGHT = 1e-8; /**< Minimum control cost weight allowed */
+static const int PROBABILITIES_BLOCK_SIZE = 256; /**< Number of parameters processed at a time during the probability calculation */
+static const double MAX_IMPORTANCE_WEIGHT = 1.0; /**< Reused rollouts are selected for their low cost, so reweighting only ever discounts them */
 
 /**
  * @brief Compute a linear interpolated trajectory given a start and end state
@@ -93,14 +98,14 @@ static void computeCubicInterpolation(const std::vector<double>& first,const std
  * @param first                        The start position
  * @param last                         The final position
  * @param control_cost_matrix_R_padded The control cost matrix with padding
- * @param inv_control_cost_matrix_R    The inverse constrol cost matrix
+ * @param control_cost_matrix_R_ldlt   The factorization of the control cost matrix
  * @param trajectory_joints            The returned minimum cost trajectory
  * @return True if successful, otherwise false
  */
 bool computeMinCostTrajectory(const std::vector<double>& first,
                               const std::vector<double>& last,
-                              const Eigen::MatrixXd& control_cost_matrix_R_padded,
-                              const Eigen::MatrixXd& inv_control_cost_matrix_R,
+                              const Eigen::SparseMatrix<double>& control_cost_matrix_R_padded,
+                              const stomp_core::ControlCostMatrixLDLT& control_cost_matrix_R_ldlt,
                               Eigen::MatrixXd& trajectory_joints)
 {
   using namespace stomp_core;
@@ -111,26 +116,50 @@ bool computeMinCostTrajectory(const std::vector<double>& first,
     return false;
   }
 
+  if(control_cost_matrix_R_ldlt.info() != Eigen::Success)
+  {
+    ROS_ERROR("Control Cost Matrix factorization failed");
+    return false;
+  }
 
   int timesteps = control_cost_matrix_R_padded.rows() - 2*(FINITE_DIFF_RULE_LENGTH - 1);
   int start_index_padded = FINITE_DIFF_RULE_LENGTH - 1;
   int end_index_padded = start_index_padded + timesteps-1;
-  std::vector<Eigen::VectorXd> linear_control_cost(first.size(),Eigen::VectorXd::Zero(timesteps));
   trajectory_joints.setZero(first.size(),timesteps);
 
-
-  for(unsigned int d = 0; d < first.size(); d++)
+  /* summing the padding rows of R, only the columns within the band of
+   * the padding are non-zero so this is independent of the number of timesteps
+   */
+  Eigen::VectorXd start_padding_costs = Eigen::VectorXd::Zero(timesteps);
+  Eigen::VectorXd end_padding_costs = Eigen::VectorXd::Zero(timesteps);
+  for(int k = 0; k < control_cost_matrix_R_padded.outerSize(); k++)
   {
-    linear_control_cost[d].transpose() = first[d] * Eigen::VectorXd::Ones(FINITE_DIFF_RULE_LENGTH - 1).transpose() *
-        control_cost_matrix_R_padded.block(0,start_index_padded,FINITE_DIFF_RULE_LENGTH - 1,timesteps);
+    int t = k - start_index_padded;
+    if(t < 0 || t >= timesteps)
+    {
+      continue;
+    }
 
-    linear_control_cost[d].transpose() += last[d] * Eigen::VectorXd::Ones(FINITE_DIFF_RULE_LENGTH - 1).transpose() *
-        control_cost_matrix_R_padded.block(end_index_padded + 1,start_index_padded,FINITE_DIFF_RULE_LENGTH - 1,
-                                    timesteps);
+    // R is symmetric, therefore column k holds the entries of row k
+    for(Eigen::SparseMatrix<double>::InnerIterator it(control_cost_matrix_R_padded,k); it; ++it)
+    {
+      if(it.row() < start_index_padded)
+      {
+        start_padding_costs(t) += it.value();
+      }
+      else if(it.row() > end_index_padded)
+      {
+        end_padding_costs(t) += it.value();
+      }
+    }
+  }
 
-    linear_control_cost[d] *=2;
+  Eigen::VectorXd linear_control_cost;
+  for(unsigned int d = 0; d < first.size(); d++)
+  {
+    linear_control_cost = 2*(first[d]*start_padding_costs + last[d]*end_padding_costs);
 
-    trajectory_joints.row(d) = -0.5*inv_control_cost_matrix_R*linear_control_cost[d];
+    trajectory_joints.row(d) = -0.5*control_cost_matrix_R_ldlt.solve(linear_control_cost);
     trajectory_joints(d,0) = first[d];
     trajectory_joints(d,timesteps - 1) = last[d];
   }
@@ -139,45 +168,49 @@ bool computeMinCostTrajectory(const std::vector<double>& first,
 }
 
 /**
- * @brief Compute the parameters control costs
- * @param parameters            The parameters used to compute the control cost
- * @param dt                    The timestep in seconds
- * @param control_cost_weight   The control cost weight
- * @param control_cost_matrix_R The control cost matrix
- * @param control_costs returns The parameters control costs
+ * @brief Runs an optimization step and adds its execution time to a phase timer
+ * @param phase_time  The accumulated phase time in seconds, the step is not timed when null
+ * @param step        The optimization step
+ * @return The value returned by the step
  */
-void computeParametersControlCosts(const Eigen::MatrixXd& parameters,
-                                          double dt,
-                                          double control_cost_weight,
-                                          const Eigen::MatrixXd& control_cost_matrix_R,
-                                          Eigen::MatrixXd& control_costs)
+template <typename Step>
+static bool timeStep(double* phase_time,Step step)
 {
-  std::size_t num_timesteps = parameters.cols();
-  double cost = 0;
-  for(auto d = 0u; d < parameters.rows(); d++)
+  if(!phase_time)
   {
-    cost = double(parameters.row(d)*(control_cost_matrix_R*parameters.row(d).transpose()));
-    control_costs.row(d).setConstant( 0.5*(1/dt)*cost );
+    return step();
   }
 
-  double max_coeff = control_costs.maxCoeff();
-  control_costs /= (max_coeff > 1e-8) ? max_coeff : 1;
-  control_costs *= control_cost_weight;
+  auto start = std::chrono::steady_clock::now();
+  bool success = step();
+  *phase_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return success;
 }
 
-
 namespace stomp_core {
 
 
 Stomp::Stomp(const StompConfiguration& config,TaskPtr task):
     config_(config),
-    task_(task)
+    task_(task),
+    statistics_(nullptr),
+    best_solution_found_(false),
+    best_valid_cost_(std::numeric_limits<double>::max()),
+    best_iteration_(0),
+    workers_generation_(0),
+    workers_pending_(0),
+    workers_exit_(false)
 {
 
   resetVariables();
 
 }
 
+Stomp::~Stomp()
+{
+  stopWorkers();
+}
+
 bool Stomp::clear()
 {
   return resetVariables();
@@ -190,19 +223,32 @@ void Stomp::setConfig(const StompConfiguration& config)
 }
 
 bool Stomp::solve(const std::vector<double>& first,const std::vector<double>& last,
-                  Eigen::MatrixXd& parameters_optimized)
+                  Eigen::MatrixXd& parameters_optimized,StompStatistics* statistics)
 {
+  auto start_time = std::chrono::steady_clock::now();
+  window_start_ = 0;
+  window_timesteps_ = config_.num_timesteps;
+
   // initialize trajectory
-  if(!computeInitialTrajectory(first,last))
+  if(config_.num_coarse_timesteps > 0 && computeCoarseTrajectory(first,last))
+  {
+    ROS_DEBUG("STOMP initialized the trajectory from a %i timesteps optimization",config_.num_coarse_timesteps);
+  }
+  else if(!proceed_)
+  {
+    ROS_ERROR_STREAM("Stomp was terminated");
+    return false;
+  }
+  else if(!computeInitialTrajectory(first,last))
   {
     ROS_ERROR("Unable to generate initial trajectory");
   }
 
-  return solve(parameters_optimized_,parameters_optimized);
+  return optimize(parameters_optimized_,parameters_optimized,statistics,start_time);
 }
 
 bool Stomp::solve(const Eigen::VectorXd& first,const Eigen::VectorXd& last,
-                  Eigen::MatrixXd& parameters_optimized)
+                  Eigen::MatrixXd& parameters_optimized,StompStatistics* statistics)
 {
   // converting to std vectors
   std::vector<double> start(first.size());
@@ -211,12 +257,117 @@ bool Stomp::solve(const Eigen::VectorXd& first,const Eigen::VectorXd& last,
   Eigen::VectorXd::Map(&start[0],first.size()) = first;
   Eigen::VectorXd::Map(&end[0],last.size()) = last;
 
-  return solve(start,end,parameters_optimized);
+  return solve(start,end,parameters_optimized,statistics);
 }
 
 bool Stomp::solve(const Eigen::MatrixXd& initial_parameters,
-                  Eigen::MatrixXd& parameters_optimized)
+                  Eigen::MatrixXd& parameters_optimized,StompStatistics* statistics)
 {
+  window_start_ = 0;
+  window_timesteps_ = config_.num_timesteps;
+  return optimize(initial_parameters,parameters_optimized,statistics,std::chrono::steady_clock::now());
+}
+
+bool Stomp::solveWindow(const Eigen::MatrixXd& initial_parameters,int start_timestep,int num_timesteps,
+                        Eigen::MatrixXd& parameters_optimized,StompStatistics* statistics)
+{
+  auto start_time = std::chrono::steady_clock::now();
+
+  int end_timestep = start_timestep + num_timesteps;
+  if(start_timestep < 0 || num_timesteps < 3 || end_timestep > config_.num_timesteps)
+  {
+    ROS_ERROR("The optimization window [%i, %i) is invalid for %i timesteps",start_timestep,end_timestep,
+              config_.num_timesteps);
+    return false;
+  }
+
+  if(initial_parameters.rows() != config_.num_dimensions || initial_parameters.cols() != config_.num_timesteps)
+  {
+    ROS_ERROR("Initial trajectory dimensions is incorrect");
+    return false;
+  }
+
+  // evaluating the fixed sections once, each includes the adjacent window boundary
+  Eigen::VectorXd costs;
+  bool valid;
+  parameters_state_costs_.setZero();
+  outside_window_valid_ = true;
+  if(start_timestep > 0)
+  {
+    if(!task_->computeCosts(initial_parameters,0,start_timestep + 1,0,costs,valid))
+    {
+      ROS_ERROR("Failed to calculate the cost before the optimization window");
+      return false;
+    }
+    parameters_state_costs_.head(start_timestep + 1) = costs;
+    outside_window_valid_ &= valid;
+  }
+
+  if(end_timestep < config_.num_timesteps)
+  {
+    int num_fixed = config_.num_timesteps - end_timestep + 1;
+    if(!task_->computeCosts(initial_parameters,end_timestep - 1,num_fixed,0,costs,valid))
+    {
+      ROS_ERROR("Failed to calculate the cost after the optimization window");
+      return false;
+    }
+    parameters_state_costs_.tail(num_fixed) = costs;
+    outside_window_valid_ &= valid;
+  }
+
+  window_start_ = start_timestep;
+  window_timesteps_ = num_timesteps;
+  parameters_optimized_ = initial_parameters;
+  bool success = optimize(initial_parameters,parameters_optimized,statistics,start_time);
+
+  window_start_ = 0;
+  window_timesteps_ = config_.num_timesteps;
+  outside_window_valid_ = true;
+  return success;
+}
+
+bool Stomp::resume(Eigen::MatrixXd& parameters_optimized,StompStatistics* statistics,
+                   int affected_start,int affected_timesteps)
+{
+  auto start_time = std::chrono::steady_clock::now();
+
+  if(num_active_rollouts_ == 0 || parameters_optimized_.cols() != config_.num_timesteps)
+  {
+    ROS_ERROR("STOMP has no previous solution to resume from");
+    return false;
+  }
+
+  if(affected_timesteps < 0)
+  {
+    affected_timesteps = config_.num_timesteps - affected_start;
+  }
+
+  if(affected_start < 0 || affected_start + affected_timesteps > config_.num_timesteps)
+  {
+    ROS_ERROR("The affected timesteps [%i, %i) exceed the number of timesteps %i",affected_start,
+              affected_start + affected_timesteps,config_.num_timesteps);
+    return false;
+  }
+
+  proceed_ = true;
+  window_start_ = 0;
+  window_timesteps_ = config_.num_timesteps;
+  if(affected_timesteps > 0 && !recomputeStoredRolloutsCosts(affected_start,affected_timesteps))
+  {
+    ROS_ERROR("Failed to update the costs of the stored rollouts");
+    return false;
+  }
+
+  Eigen::MatrixXd initial_parameters = parameters_optimized_;
+  return optimize(initial_parameters,parameters_optimized,statistics,start_time);
+}
+
+bool Stomp::optimize(const Eigen::MatrixXd& initial_parameters,Eigen::MatrixXd& parameters_optimized,
+                     StompStatistics* statistics,std::chrono::steady_clock::time_point start_time)
+{
+  deadline_ = start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(config_.max_solve_time));
+
   if(parameters_optimized_.isZero())
   {
     parameters_optimized_ = initial_parameters;
@@ -237,22 +388,59 @@ bool Stomp::solve(const Eigen::MatrixXd& initial_parameters,
     }
   }
 
-  current_iteration_ = 1;
+  // preparing worker threads tasks
+  if(config_.num_threads <= 1)
+  {
+    worker_tasks_.clear();
+  }
+  else if(!setupWorkerTasks())
+  {
+    ROS_WARN("Task does not support parallel evaluation, rollouts will be evaluated serially");
+  }
+  workspaces_.resize(std::max<std::size_t>(worker_tasks_.size(),1));
+
   unsigned int valid_iterations = 0;
+  noise_scale_.setOnes(config_.num_dimensions);
+  noise_energies_sum_.setZero(config_.num_dimensions);
+  noise_energies_samples_ = 0;
   current_lowest_cost_ = std::numeric_limits<double>::max();
+  cost_history_.clear();
+
+  // initializing statistics
+  statistics_ = statistics;
+  if(statistics_)
+  {
+    *statistics_ = StompStatistics();
+    statistics_->cost_history.reserve(config_.num_iterations);
+    statistics_->threads = worker_tasks_.empty() ? 1 : std::min<int>(worker_tasks_.size(),config_.num_rollouts);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(best_solution_mutex_);
+    best_solution_found_ = false;
+    best_valid_cost_ = std::numeric_limits<double>::max();
+  }
 
-  // computing initialial trajectory cost
+  // computing initialial trajectory cost, it is published as iteration 0 when valid
+  current_iteration_ = 0;
   if(!computeOptimizedCost())
   {
     ROS_ERROR("Failed to calculate initial trajectory cost");
+    statistics_ = nullptr;
     return false;
   }
 
+  current_iteration_ = 1;
   while(current_iteration_ <= config_.num_iterations && runSingleIteration())
   {
 
     ROS_DEBUG("STOMP completed iteration %i with cost %f",current_iteration_,current_lowest_cost_);
 
+    if(statistics_)
+    {
+      statistics_->iterations = current_iteration_;
+      statistics_->cost_history.push_back(current_lowest_cost_);
+    }
 
     if(parameters_valid_)
     {
@@ -271,6 +459,11 @@ bool Stomp::solve(const Eigen::MatrixXd& initial_parameters,
       break;
     }
 
+    if(hasConverged())
+    {
+      break;
+    }
+
     current_iteration_++;
   }
 
@@ -281,13 +474,23 @@ bool Stomp::solve(const Eigen::MatrixXd& initial_parameters,
   }
   else
   {
-    if (proceed_)
-      ROS_ERROR("STOMP failed to find a valid solution after %i iterations",current_iteration_);
-    else
+    if (!proceed_)
       ROS_ERROR_STREAM("Stomp was terminated");
+    else if (isPastDeadline())
+      ROS_ERROR("STOMP exceeded the allowed time of %f seconds after %i iterations",config_.max_solve_time,current_iteration_);
+    else
+      ROS_ERROR("STOMP failed to find a valid solution after %i iterations",current_iteration_);
   }
 
   parameters_optimized = parameters_optimized_;
+  stopWorkers();
+
+  if(statistics_)
+  {
+    statistics_->total_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    ROS_DEBUG_STREAM("STOMP statistics:\n"<<toString(*statistics_));
+    statistics_ = nullptr;
+  }
 
   // notifying task
   task_->done(parameters_valid_,current_iteration_,current_lowest_cost_,parameters_optimized);
@@ -299,6 +502,10 @@ bool Stomp::resetVariables()
 {
   proceed_= true;
   parameters_total_cost_ = 0;
+  stopWorkers();
+  workspaces_.resize(1);
+  cost_history_.clear();
+  cost_history_.reserve(config_.num_iterations + 1);
   parameters_valid_ = false;
   num_active_rollouts_ = 0;
   current_iteration_ = 0;
@@ -314,7 +521,11 @@ bool Stomp::resetVariables()
   int d = config_.num_dimensions;
   num_active_rollouts_ = 0;
   noisy_rollouts_.resize(config_.max_rollouts);
-  reused_rollouts_.resize(config_.max_rollouts);
+  rollout_indices_.resize(config_.max_rollouts);
+  std::iota(rollout_indices_.begin(),rollout_indices_.end(),0);
+  rollout_cost_sorter_.reserve(config_.max_rollouts);
+  previous_rollout_indices_.resize(config_.max_rollouts);
+  kept_rollouts_.resize(config_.max_rollouts);
 
   // initializing rollout
   Rollout rollout;
@@ -324,9 +535,6 @@ bool Stomp::resetVariables()
   rollout.parameters_noise.resize(d, config_.num_timesteps);
   rollout.parameters_noise.setZero();
 
-  rollout.probabilities.resize(d, config_.num_timesteps);
-  rollout.probabilities.setZero();
-
   rollout.full_probabilities.clear();
   rollout.full_probabilities.resize(d);
 
@@ -343,13 +551,27 @@ bool Stomp::resetVariables()
   rollout.state_costs.setZero();
 
   rollout.importance_weight = DEFAULT_NOISY_COST_IMPORTANCE_WEIGHT;
+  rollout.sampling_energies.setZero(d);
+  rollout.sampling_scales.setOnes(d);
 
   for(unsigned int r = 0; r < config_.max_rollouts ; r++)
   {
     noisy_rollouts_[r] = rollout;
-    reused_rollouts_[r] = rollout;
   }
 
+  // probability calculation workspace
+  rollouts_probabilities_.setZero(d*config_.num_timesteps,config_.max_rollouts);
+  rollouts_costs_.setZero(d*config_.num_timesteps,config_.max_rollouts);
+  rollouts_min_costs_.setZero(d*config_.num_timesteps);
+  rollouts_cost_scale_.setZero(d*config_.num_timesteps);
+  rollouts_weights_.setZero(config_.max_rollouts);
+  rollouts_full_costs_.setZero(d,config_.max_rollouts);
+  rollouts_noise_energies_.setZero(d,config_.max_rollouts);
+  noise_energies_sum_.setZero(d);
+  noise_energies_samples_ = 0;
+  sampled_noise_moment_.setZero(d);
+  weighted_noise_moment_.setZero(d);
+
   // parameter updates
   parameters_updates_.resize(d, config_.num_timesteps);
   parameters_updates_.setZero();
@@ -363,28 +585,113 @@ bool Stomp::resetVariables()
   parameters_optimized_.resize(config_.num_dimensions,config_.num_timesteps);
   parameters_optimized_.setZero();
 
-  // generate finite difference matrix
+  {
+    std::lock_guard<std::mutex> lock(best_solution_mutex_);
+    best_parameters_.setZero(config_.num_dimensions,config_.num_timesteps);
+  }
+
+  // optimizing all timesteps
+  window_start_ = 0;
+  window_timesteps_ = config_.num_timesteps;
+  outside_window_valid_ = true;
+
+  // the groups planned for are usually 6 or 7 dof, any other number of dimensions uses the dynamic sizes
+  switch(config_.num_dimensions)
+  {
+    case 6:
+      kernels_ = StompKernelTable::create<6>();
+      break;
+    case 7:
+      kernels_ = StompKernelTable::create<7>();
+      break;
+    default:
+      kernels_ = StompKernelTable::create<Eigen::Dynamic>();
+      break;
+  }
+
+  // finite difference and control cost matrices
   start_index_padded_ = FINITE_DIFF_RULE_LENGTH-1;
   num_timesteps_padded_ = config_.num_timesteps + 2*(FINITE_DIFF_RULE_LENGTH-1);
-  generateFiniteDifferenceMatrix(num_timesteps_padded_,DerivativeOrders::STOMP_ACCELERATION,
-                                 config_.delta_t,finite_diff_matrix_A_padded_);
+  control_cost_matrices_ = getControlCostMatrices(config_.num_timesteps,config_.delta_t);
+  if(control_cost_matrices_->control_cost_matrix_R_ldlt.info() != Eigen::Success)
+  {
+    ROS_ERROR("Failed to factorize the control cost matrix");
+    return false;
+  }
 
-  /* control cost matrix (R = A_transpose * A):
-   * Note: Original code multiplies the A product by the time interval.  However this is not
-   * what was described in the literature
-   */
-  control_cost_matrix_R_padded_ = config_.delta_t*finite_diff_matrix_A_padded_.transpose() * finite_diff_matrix_A_padded_;
-  control_cost_matrix_R_ = control_cost_matrix_R_padded_.block(
-      start_index_padded_,start_index_padded_,config_.num_timesteps,config_.num_timesteps);
-  inv_control_cost_matrix_R_ = control_cost_matrix_R_.fullPivLu().inverse();
+  return true;
+}
 
-  /*
-   * Applying scale factor to ensure that max(R^-1)==1
-   */
-  double maxVal = std::abs(inv_control_cost_matrix_R_.maxCoeff());
-  control_cost_matrix_R_padded_ *= maxVal;
-  control_cost_matrix_R_ *= maxVal;
-  inv_control_cost_matrix_R_ /= maxVal; // used in computing the minimum control cost initial trajectory
+bool Stomp::hasConverged()
+{
+  cost_history_.push_back(current_lowest_cost_);
+
+  // an invalid trajectory keeps iterating until it becomes valid or the iterations run out
+  if(!parameters_valid_)
+  {
+    return false;
+  }
+
+  if(current_lowest_cost_ <= config_.cost_target)
+  {
+    ROS_DEBUG("STOMP reached the cost target %f",config_.cost_target);
+    return true;
+  }
+
+  int n = config_.convergence_iterations;
+  if(n > 0 && cost_history_.size() > n)
+  {
+    double previous_cost = cost_history_[cost_history_.size() - 1 - n];
+    double improvement = previous_cost - current_lowest_cost_;
+    if(improvement <= config_.convergence_threshold*std::abs(previous_cost))
+    {
+      ROS_DEBUG("STOMP cost improved by %f over the last %i iterations, stopping",improvement,n);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool Stomp::isPastDeadline() const
+{
+  return config_.max_solve_time > 0 && std::chrono::steady_clock::now() > deadline_;
+}
+
+bool Stomp::setupWorkerTasks()
+{
+  stopWorkers();
+  if(task_->isThreadSafe())
+  {
+    worker_tasks_.assign(config_.num_threads,task_);
+    return true;
+  }
+
+  // the clones of the previous optimization are reused
+  if(!worker_tasks_.empty() && worker_tasks_.front() == task_)
+  {
+    worker_tasks_.clear();
+  }
+  worker_tasks_.resize(config_.num_threads);
+
+  for(auto& worker_task : worker_tasks_)
+  {
+    if(worker_task && !task_->updateClone(*worker_task))
+    {
+      worker_task.reset();
+    }
+
+    if(!worker_task)
+    {
+      worker_task = task_->clone();
+    }
+
+    if(!worker_task)
+    {
+      worker_tasks_.clear();
+      return false;
+    }
+  }
 
   return true;
 }
@@ -405,36 +712,122 @@ bool Stomp::computeInitialTrajectory(const std::vector<double>& first,const std:
       break;
     case TrajectoryInitializations::MININUM_CONTROL_COST:
 
-      valid = computeMinCostTrajectory(first,last,control_cost_matrix_R_padded_,inv_control_cost_matrix_R_,parameters_optimized_);
+      valid = computeMinCostTrajectory(first,last,control_cost_matrices_->control_cost_matrix_R_padded,
+                                       control_cost_matrices_->control_cost_matrix_R_ldlt,parameters_optimized_);
       break;
   }
 
   return valid;
 }
 
+bool Stomp::computeCoarseTrajectory(const std::vector<double>& first,const std::vector<double>& last)
+{
+  int num_coarse_timesteps = config_.num_coarse_timesteps;
+  if(num_coarse_timesteps < 3 || num_coarse_timesteps >= config_.num_timesteps)
+  {
+    ROS_WARN("'num_coarse_timesteps' must be in the range [3, %i), skipping the coarse optimization",config_.num_timesteps);
+    return false;
+  }
+
+  if(!task_->setNumTimesteps(num_coarse_timesteps))
+  {
+    ROS_WARN("Task does not support %i timesteps, skipping the coarse optimization",num_coarse_timesteps);
+    return false;
+  }
+
+  // same trajectory duration sampled with fewer timesteps
+  StompConfiguration coarse_config = config_;
+  coarse_config.num_timesteps = num_coarse_timesteps;
+  coarse_config.delta_t = config_.delta_t*(config_.num_timesteps - 1)/(num_coarse_timesteps - 1);
+  coarse_config.num_coarse_timesteps = 0;
+  if(config_.num_coarse_iterations > 0)
+  {
+    coarse_config.num_iterations = config_.num_coarse_iterations;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(coarse_stomp_mutex_);
+    if(!proceed_)
+    {
+      task_->setNumTimesteps(config_.num_timesteps);
+      return false;
+    }
+    coarse_stomp_ = std::make_shared<Stomp>(coarse_config,task_);
+  }
+
+  Eigen::MatrixXd coarse_parameters;
+  bool coarse_valid = coarse_stomp_->solve(first,last,coarse_parameters);
+
+  {
+    std::lock_guard<std::mutex> lock(coarse_stomp_mutex_);
+    coarse_stomp_.reset();
+  }
+
+  if(!task_->setNumTimesteps(config_.num_timesteps))
+  {
+    ROS_ERROR("Task failed to restore %i timesteps after the coarse optimization",config_.num_timesteps);
+    return false;
+  }
+
+  // an invalid coarse solution is still a better guess than the plain initialization
+  if(!proceed_ || coarse_parameters.rows() != config_.num_dimensions || coarse_parameters.cols() != num_coarse_timesteps)
+  {
+    return false;
+  }
+
+  ROS_DEBUG("STOMP coarse optimization finished, valid: %s",coarse_valid ? "true" : "false");
+  resampleParameters(coarse_parameters,config_.num_timesteps,parameters_optimized_);
+  return true;
+}
+
+bool Stomp::getBestSolution(Eigen::MatrixXd& parameters,double& cost,int& iteration) const
+{
+  std::lock_guard<std::mutex> lock(best_solution_mutex_);
+  if(!best_solution_found_)
+  {
+    return false;
+  }
+
+  parameters = best_parameters_;
+  cost = best_valid_cost_;
+  iteration = best_iteration_;
+  return true;
+}
+
 bool Stomp::cancel()
 {
   ROS_WARN("Interrupting STOMP");
   proceed_ = false;
+
+  std::lock_guard<std::mutex> lock(coarse_stomp_mutex_);
+  if(coarse_stomp_)
+  {
+    coarse_stomp_->cancel();
+  }
   return !proceed_;
 }
 
 bool Stomp::runSingleIteration()
 {
-  if(!proceed_)
+  if(!proceed_ || isPastDeadline())
   {
     return false;
   }
 
-  bool proceed = generateNoisyRollouts() &&
+  bool proceed = timeStep(statistics_ ? &statistics_->noise_generation_time : nullptr,
+                          [this](){ return generateNoisyRollouts(); }) &&
       computeNoisyRolloutsCosts() &&
-      filterNoisyRollouts() &&
-      computeProbabilities() &&
-      updateParameters() &&
-      computeOptimizedCost();
+      timeStep(statistics_ ? &statistics_->noisy_filters_time : nullptr,
+               [this](){ return filterNoisyRollouts(); }) &&
+      timeStep(statistics_ ? &statistics_->probabilities_time : nullptr,
+               [this](){ return computeImportanceWeights() && computeProbabilities(); }) &&
+      timeStep(statistics_ ? &statistics_->update_filters_time : nullptr,
+               [this](){ return updateParameters() && adaptNoise(); }) &&
+      timeStep(statistics_ ? &statistics_->optimized_cost_time : nullptr,
+               [this](){ return computeOptimizedCost(); });
 
   // notifying end of iteration
-  task_->postIteration(0,config_.num_timesteps,current_iteration_,current_lowest_cost_,parameters_optimized_);
+  task_->postIteration(window_start_,window_timesteps_,current_iteration_,current_lowest_cost_,parameters_optimized_);
 
   return proceed;
 }
@@ -442,7 +835,6 @@ bool Stomp::runSingleIteration()
 bool Stomp::generateNoisyRollouts()
 {
   // calculating number of rollouts to reuse from previous iteration
-  std::vector< std::pair<double,int> > rollout_cost_sorter; // Used to sort noisy trajectories in ascending order wrt their total cost
   double h = config_.exponentiated_cost_sensitivity;
   int rollouts_stored = num_active_rollouts_-1; // don't take the optimized rollout into account
   rollouts_stored = rollouts_stored < 0 ? 0 : rollouts_stored;
@@ -458,7 +850,7 @@ bool Stomp::generateNoisyRollouts()
     double max_cost = std::numeric_limits<double>::min();
     for (int r=1; r<rollouts_stored; ++r)
     {
-      double c = noisy_rollouts_[r].total_cost;
+      double c = noisy_rollouts_[rollout_indices_[r]].total_cost;
       if (c < min_cost)
         min_cost = c;
       if (c > max_cost)
@@ -472,70 +864,115 @@ bool Stomp::generateNoisyRollouts()
     // compute weighted cost on all rollouts
     double cost_prob;
     double weighted_prob;
+    rollout_cost_sorter_.clear();
     for (auto r = 0u; r<rollouts_stored; ++r)
     {
+      Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
 
       // Apply noise generated on the previous iteration onto the current trajectory
-      noisy_rollouts_[r].noise = noisy_rollouts_[r].parameters_noise
-          - parameters_optimized_;
+      rollout.noise = rollout.parameters_noise - parameters_optimized_;
 
-      cost_prob = exp(-h*(noisy_rollouts_[r].total_cost - min_cost)/cost_denom);
-      weighted_prob = cost_prob * noisy_rollouts_[r].importance_weight;
-      rollout_cost_sorter.push_back(std::make_pair(-weighted_prob,r));
+      cost_prob = exp(-h*(rollout.total_cost - min_cost)/cost_denom);
+      weighted_prob = cost_prob * rollout.importance_weight;
+      rollout_cost_sorter_.push_back(std::make_pair(-weighted_prob,r));
     }
 
 
-    std::sort(rollout_cost_sorter.begin(), rollout_cost_sorter.end());
+    std::sort(rollout_cost_sorter_.begin(), rollout_cost_sorter_.end());
 
-    // use the best ones: (copy them into reused_rollouts)
-    for (auto r = 0u; r<rollouts_stored; ++r)
+    /* use the best ones by moving their storage indices into the reuse range [rollouts_generate, rollouts_generate + rollouts_reuse),
+     * the storage of the remaining rollouts is recycled for the new rollouts and the optimized parameters.
+     */
+    std::copy(rollout_indices_.begin(),rollout_indices_.end(),previous_rollout_indices_.begin());
+    std::fill(kept_rollouts_.begin(),kept_rollouts_.end(),false);
+    for (auto r = 0u; r<rollouts_reuse; ++r)
     {
-      int reuse_index = rollout_cost_sorter[r].second;
-      reused_rollouts_[r] = noisy_rollouts_[reuse_index];
+      int storage_index = previous_rollout_indices_[rollout_cost_sorter_[r].second];
+      rollout_indices_[rollouts_generate + r] = storage_index;
+      kept_rollouts_[storage_index] = true;
     }
 
-    // copy them back from reused_rollouts_ into rollouts_
-    for (auto r = 0u; r<rollouts_reuse; ++r)
+    int free_position = 0;
+    for (auto r = 0u; r < previous_rollout_indices_.size(); ++r)
     {
-      noisy_rollouts_[rollouts_generate + r ] = reused_rollouts_[r];
+      int storage_index = previous_rollout_indices_[r];
+      if(kept_rollouts_[storage_index])
+      {
+        continue;
+      }
+
+      if(free_position == rollouts_generate)
+      {
+        free_position += rollouts_reuse; // skipping the reuse range
+      }
+      rollout_indices_[free_position++] = storage_index;
     }
   }
 
   // adding optimized trajectory as the last rollout
-  noisy_rollouts_[rollouts_generate + rollouts_reuse].parameters_noise = parameters_optimized_;
-  noisy_rollouts_[rollouts_generate + rollouts_reuse].noise.setZero();
-  noisy_rollouts_[rollouts_generate + rollouts_reuse].state_costs = parameters_state_costs_;
-  noisy_rollouts_[rollouts_generate + rollouts_reuse].control_costs = parameters_control_costs_;
+  Rollout& optimized_rollout = noisy_rollouts_[rollout_indices_[rollouts_generate + rollouts_reuse]];
+  optimized_rollout.parameters_noise = parameters_optimized_;
+  optimized_rollout.noise.setZero();
+  optimized_rollout.importance_weight = DEFAULT_NOISY_COST_IMPORTANCE_WEIGHT;
+  optimized_rollout.state_costs = parameters_state_costs_;
+  optimized_rollout.control_costs = parameters_control_costs_;
 
 
   // generate new noisy rollouts
   for(auto r = 0u; r < rollouts_generate; r++)
   {
+    Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
     if(!task_->generateNoisyParameters(parameters_optimized_,
-                                      0,config_.num_timesteps,
+                                      window_start_,window_timesteps_,
                                       current_iteration_,r,
-                                      noisy_rollouts_[r].parameters_noise,
-                                      noisy_rollouts_[r].noise))
+                                      rollout.parameters_noise,
+                                      rollout.noise))
     {
       ROS_ERROR("Failed to generate noisy parameters at iteration %i",current_iteration_);
       return false;
     }
 
+    if(config_.noise_adaptation_rate > 0)
+    {
+      rollout.noise.array().colwise() *= noise_scale_.array();
+      rollout.parameters_noise = parameters_optimized_ + rollout.noise;
+    }
+
+    if(window_timesteps_ < config_.num_timesteps)
+    {
+      maskNoise(rollout);
+    }
+
   }
 
   // update total active rollouts
   num_active_rollouts_ = rollouts_reuse + rollouts_generate + 1;
 
+  if(statistics_)
+  {
+    statistics_->rollouts_evaluated += rollouts_generate;
+    statistics_->rollouts_reused += rollouts_reuse;
+  }
+
   return true;
 }
 
+void Stomp::maskNoise(Rollout& rollout)
+{
+  int num_fixed_after = config_.num_timesteps - (window_start_ + window_timesteps_) + 1;
+  rollout.noise.leftCols(window_start_ + 1).setZero();
+  rollout.noise.rightCols(num_fixed_after).setZero();
+  rollout.parameters_noise = parameters_optimized_ + rollout.noise;
+}
+
 bool Stomp::filterNoisyRollouts()
 {
   // apply post noise generation filters
   bool filtered = false;
   for(auto r = 0u ; r < config_.num_rollouts; r++)
   {
-    if(!task_->filterNoisyParameters(0,config_.num_timesteps,current_iteration_,r,noisy_rollouts_[r].parameters_noise,filtered))
+    Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
+    if(!task_->filterNoisyParameters(window_start_,window_timesteps_,current_iteration_,r,rollout.parameters_noise,filtered))
     {
       ROS_ERROR_STREAM("Failed to filter noisy parameters");
       return false;
@@ -543,7 +980,11 @@ bool Stomp::filterNoisyRollouts()
 
     if(filtered)
     {
-      noisy_rollouts_[r].noise = noisy_rollouts_[r].parameters_noise - parameters_optimized_;
+      rollout.noise = rollout.parameters_noise - parameters_optimized_;
+      if(window_timesteps_ < config_.num_timesteps)
+      {
+        maskNoise(rollout);
+      }
     }
   }
 
@@ -553,59 +994,74 @@ bool Stomp::filterNoisyRollouts()
 bool Stomp::computeNoisyRolloutsCosts()
 {
   // computing state and control costs
-  bool valid = computeRolloutsStateCosts() && computeRolloutsControlCosts();
+  bool valid = timeStep(statistics_ ? &statistics_->state_costs_time : nullptr,
+                        [this](){ return computeRolloutsStateCosts(); }) &&
+      timeStep(statistics_ ? &statistics_->control_costs_time : nullptr,
+               [this](){ return computeRolloutsControlCosts(); });
 
   if(valid)
   {
-    // compute total costs
-    double total_state_cost ;
-    double total_control_cost;
+    computeRolloutsTotalCosts();
+  }
 
-    for(auto r = 0u ; r < num_active_rollouts_;r++)
-    {
-      Rollout& rollout = noisy_rollouts_[r];
-      total_state_cost = rollout.state_costs.sum();
+  return valid;
+}
 
-      // Compute control + state cost for each joint
-      total_control_cost = 0;
-      double ccost = 0;
-      for(auto d = 0u; d < config_.num_dimensions; d++)
-      {
-        ccost = rollout.control_costs.row(d).sum();
-        total_control_cost += ccost;
-        rollout.full_costs[d] = ccost + total_state_cost;
-      }
-      rollout.total_cost = total_state_cost + total_control_cost;
+void Stomp::computeRolloutsTotalCosts()
+{
+  for(auto r = 0u ; r < num_active_rollouts_;r++)
+  {
+    kernels_.computeTotalCosts(noisy_rollouts_[rollout_indices_[r]]);
+  }
+}
 
-      // Compute total cost for each time step
-      for(auto d = 0u; d < config_.num_dimensions; d++)
-      {
-        rollout.total_costs.row(d) = rollout.state_costs.transpose() + rollout.control_costs.row(d);
-      }
+bool Stomp::recomputeStoredRolloutsCosts(int start_timestep,int num_timesteps)
+{
+  Eigen::VectorXd costs;
+  bool valid;
+  for(auto r = 0u ; r < num_active_rollouts_; r++)
+  {
+    if(!proceed_)
+    {
+      return false;
     }
+
+    Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
+    if(!task_->computeNoisyCosts(rollout.parameters_noise,start_timestep,num_timesteps,0,r,costs,valid))
+    {
+      ROS_ERROR("Trajectory cost computation failed for stored rollout %i.",r);
+      return false;
+    }
+    rollout.state_costs.segment(start_timestep,num_timesteps) = costs;
   }
 
-  return valid;
+  computeRolloutsTotalCosts();
+  return true;
 }
 
 bool Stomp::computeRolloutsStateCosts()
 {
+  if(!worker_tasks_.empty())
+  {
+    return computeRolloutsStateCostsParallel();
+  }
 
-  bool all_valid = true;
+  if(task_->hasBatchCosts())
+  {
+    return proceed_ && !isPastDeadline() && computeRolloutsStateCostsBatch(*task_,0,1,workspaces_[0]);
+  }
+
+  Eigen::VectorXd& window_costs = workspaces_[0].window_costs;
   bool proceed = true;
   for(auto r = 0u ; r < config_.num_rollouts; r++)
   {
-    if(!proceed_)
+    if(!proceed_ || isPastDeadline())
     {
       proceed = false;
       break;
     }
 
-    Rollout& rollout = noisy_rollouts_[r];
-    if(!task_->computeNoisyCosts(rollout.parameters_noise,0,
-                            config_.num_timesteps,
-                            current_iteration_,r,
-                            rollout.state_costs,all_valid))
+    if(!computeRolloutStateCosts(*task_,r,window_costs))
     {
       ROS_ERROR("Trajectory cost computation failed for rollout %i.",r);
       proceed = false;
@@ -615,148 +1071,399 @@ bool Stomp::computeRolloutsStateCosts()
 
   return proceed;
 }
-bool Stomp::computeRolloutsControlCosts()
+
+bool Stomp::computeRolloutStateCosts(Task& task,int r,Eigen::VectorXd& window_costs)
 {
-  Eigen::ArrayXXd Ax; // accelerations
-  for(auto r = 0u ; r < num_active_rollouts_; r++)
+  bool valid;
+  Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
+  if(window_timesteps_ == config_.num_timesteps)
   {
-    Rollout& rollout = noisy_rollouts_[r];
+    return task.computeNoisyCosts(rollout.parameters_noise,0,config_.num_timesteps,current_iteration_,r,
+                                  rollout.state_costs,valid);
+  }
 
-    if(config_.control_cost_weight < MIN_CONTROL_COST_WEIGHT)
+  if(!task.computeNoisyCosts(rollout.parameters_noise,window_start_,window_timesteps_,current_iteration_,r,
+                             window_costs,valid))
+  {
+    return false;
+  }
+
+  rollout.state_costs = parameters_state_costs_;
+  rollout.state_costs.segment(window_start_,window_timesteps_) = window_costs;
+  return true;
+}
+
+bool Stomp::computeRolloutsStateCostsParallel()
+{
+  if(worker_threads_.empty())
+  {
+    startWorkers();
+  }
+
+  // handing the rollouts to the workers and waiting for all of them to finish
+  {
+    std::lock_guard<std::mutex> lock(workers_mutex_);
+    workers_pending_ = worker_threads_.size();
+    workers_generation_++;
+  }
+  workers_start_cv_.notify_all();
+
+  {
+    std::unique_lock<std::mutex> lock(workers_mutex_);
+    workers_done_cv_.wait(lock,[this](){ return workers_pending_ == 0; });
+  }
+
+  return std::all_of(workers_success_.begin(),workers_success_.end(),[](char success){ return success; });
+}
+
+bool Stomp::computeWorkerRolloutsStateCosts(int w)
+{
+  // worker 'w' evaluates rollouts w, w + num_workers, w + 2*num_workers, ...
+  int num_workers = worker_threads_.size();
+  TaskPtr& task = worker_tasks_[w];
+  EvaluationWorkspace& workspace = workspaces_[w];
+  if(task->hasBatchCosts())
+  {
+    return proceed_ && !isPastDeadline() && computeRolloutsStateCostsBatch(*task,w,num_workers,workspace);
+  }
+
+  for(int r = w ; r < config_.num_rollouts; r += num_workers)
+  {
+    if(!proceed_ || isPastDeadline())
     {
-      for(auto d = 0u; d < config_.num_dimensions; d++)
-      {
-        rollout.control_costs.row(d).setConstant(0);
-      }
+      return false;
     }
-    else
+
+    if(!computeRolloutStateCosts(*task,r,workspace.window_costs))
     {
-      computeParametersControlCosts(rollout.parameters_noise,
-                                    config_.delta_t,
-                                    config_.control_cost_weight,
-                                    control_cost_matrix_R_,rollout.control_costs);
+      ROS_ERROR("Trajectory cost computation failed for rollout %i.",r);
+      return false;
     }
   }
+
   return true;
 }
 
-bool Stomp::computeProbabilities()
+void Stomp::startWorkers()
 {
+  int num_workers = std::min<int>(worker_tasks_.size(),config_.num_rollouts);
+  workers_success_.assign(num_workers,true);
+  workers_exit_ = false;
+  worker_threads_.reserve(num_workers);
+  for(int w = 0; w < num_workers; w++)
+  {
+    worker_threads_.emplace_back(&Stomp::runWorker,this,w,workers_generation_);
+  }
+}
 
-  double cost;
-  double min_cost;
-  double max_cost;
-  double denom;
-  double numerator;
-  double probl_sum = 0.0; // total probability sum of all rollouts for each joint
-  const double h = config_.exponentiated_cost_sensitivity;
-  double exponent = 0;
+void Stomp::stopWorkers()
+{
+  if(worker_threads_.empty())
+  {
+    return;
+  }
 
-  for (auto d = 0u; d<config_.num_dimensions; ++d)
   {
+    std::lock_guard<std::mutex> lock(workers_mutex_);
+    workers_exit_ = true;
+  }
+  workers_start_cv_.notify_all();
 
-    for (auto t = 0u; t<config_.num_timesteps; t++)
-    {
+  for(auto& worker : worker_threads_)
+  {
+    worker.join();
+  }
+  worker_threads_.clear();
+}
 
-      // find min and max cost over all rollouts at timestep 't':
-      min_cost = noisy_rollouts_[0].total_costs(d,t);
-      max_cost = min_cost;
-      for (auto r=0u; r<num_active_rollouts_; ++r)
+void Stomp::runWorker(int w,int generation)
+{
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(workers_mutex_);
+      workers_start_cv_.wait(lock,[&](){ return workers_exit_ || workers_generation_ != generation; });
+      if(workers_exit_)
       {
-          cost = noisy_rollouts_[r].total_costs(d,t);
-          if (cost < min_cost)
-              min_cost = cost;
-          if (cost > max_cost)
-              max_cost = cost;
+        return;
       }
+      generation = workers_generation_;
+    }
 
-      denom = max_cost - min_cost;
+    workers_success_[w] = computeWorkerRolloutsStateCosts(w);
 
-      // prevent division by zero:
-      if (denom < MIN_COST_DIFFERENCE)
-      {
-        denom = MIN_COST_DIFFERENCE;
-      }
+    {
+      std::lock_guard<std::mutex> lock(workers_mutex_);
+      workers_pending_--;
+    }
+    workers_done_cv_.notify_one();
+  }
+}
 
-      probl_sum = 0.0;
-      for (auto r = 0u; r<num_active_rollouts_; ++r)
-      {
-        // this is the exponential term in the probability calculation described in the literature
-        exponent = -h*(noisy_rollouts_[r].total_costs(d,t) - min_cost)/denom;
-        noisy_rollouts_[r].probabilities(d,t) = noisy_rollouts_[r].importance_weight *
-            exp(exponent);
+bool Stomp::computeRolloutsStateCostsBatch(Task& task,int first_rollout,int stride,EvaluationWorkspace& workspace)
+{
+  bool windowed = window_timesteps_ < config_.num_timesteps;
+  std::vector<const Eigen::MatrixXd*>& parameters = workspace.batch_parameters;
+  std::vector<Eigen::VectorXd*>& costs = workspace.batch_costs;
+  std::vector<int>& rollout_numbers = workspace.batch_rollout_numbers;
+  std::vector<Eigen::VectorXd>& window_costs = workspace.batch_window_costs;
+  parameters.clear();
+  costs.clear();
+  rollout_numbers.clear();
+  if(windowed && window_costs.size() < config_.num_rollouts)
+  {
+    window_costs.resize(config_.num_rollouts);
+  }
 
-        probl_sum += noisy_rollouts_[r].probabilities(d,t);
-      }
+  for(int r = first_rollout; r < config_.num_rollouts; r += stride)
+  {
+    Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
+    parameters.push_back(&rollout.parameters_noise);
+    costs.push_back(windowed ? &window_costs[rollout_numbers.size()] : &rollout.state_costs);
+    rollout_numbers.push_back(r);
+  }
+
+  bool valid;
+  if(!task.computeNoisyCostsBatch(parameters,window_start_,window_timesteps_,current_iteration_,rollout_numbers,
+                                  costs,valid))
+  {
+    ROS_ERROR("Trajectory cost computation failed for the batch of %lu rollouts.",rollout_numbers.size());
+    return false;
+  }
+
+  for(auto i = 0u; windowed && i < rollout_numbers.size(); i++)
+  {
+    Rollout& rollout = noisy_rollouts_[rollout_indices_[rollout_numbers[i]]];
+    rollout.state_costs = parameters_state_costs_;
+    rollout.state_costs.segment(window_start_,window_timesteps_) = window_costs[i];
+  }
+
+  return true;
+}
 
-      // scaling each probability value by the sum of all probabilities corresponding to all rollouts at time "t"
-      for (auto r = 0u; r<num_active_rollouts_; ++r)
+bool Stomp::computeRolloutsControlCosts()
+{
+  Eigen::ArrayXXd Ax; // accelerations
+  for(auto r = 0u ; r < num_active_rollouts_; r++)
+  {
+    Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
+
+    if(config_.control_cost_weight < MIN_CONTROL_COST_WEIGHT)
+    {
+      for(auto d = 0u; d < config_.num_dimensions; d++)
       {
-        noisy_rollouts_[r].probabilities(d,t) /= probl_sum;
+        rollout.control_costs.row(d).setConstant(0);
       }
     }
-
-
-    // computing full probabilities
-    min_cost = noisy_rollouts_[0].full_costs[d];
-    max_cost = min_cost;
-    double c = 0.0;
-    for (int r=1; r<num_active_rollouts_; ++r)
+    else
     {
-      c = noisy_rollouts_[r].full_costs[d];
-      if (c < min_cost)
-        min_cost = c;
-      if (c > max_cost)
-        max_cost = c;
+      kernels_.computeControlCosts(rollout.parameters_noise,
+                                   config_.delta_t,
+                                   config_.control_cost_weight,
+                                   control_cost_matrices_->control_cost_matrix_R,rollout.control_costs);
     }
+  }
+  return true;
+}
 
-    denom = max_cost - min_cost;
-    denom = denom < MIN_COST_DIFFERENCE ? MIN_COST_DIFFERENCE : denom;
+bool Stomp::computeImportanceWeights()
+{
+  // without reweighting, or when no rollouts are ever reused, every rollout keeps its default weight
+  if(!config_.reweight_reused_rollouts || config_.max_rollouts <= config_.num_rollouts)
+  {
+    return true;
+  }
+
+  const int num_new_rollouts = config_.num_rollouts;
+  const int num_noisy_rollouts = num_active_rollouts_ - 1; // the optimized parameters are sampled with no noise
+  auto energies = rollouts_noise_energies_.leftCols(num_noisy_rollouts);
+
+  for(auto r = 0u; r < num_noisy_rollouts; r++)
+  {
+    kernels_.computeQuadraticCosts(noisy_rollouts_[rollout_indices_[r]].noise,
+                                   control_cost_matrices_->control_cost_matrix_R,energies.col(r).data());
+    energies.col(r).array() /= noise_scale_.array().square();
+  }
 
-    probl_sum = 0.0;
-    for (int r=0; r<num_active_rollouts_; ++r)
+  // E[noise * R * noise_transpose] = variance * timesteps when noise ~ N(0, variance * R^-1)
+  noise_energies_sum_ += energies.leftCols(num_new_rollouts).rowwise().sum();
+  noise_energies_samples_ += num_new_rollouts;
+  const double num_energy_timesteps = noise_energies_samples_*config_.num_timesteps;
+  auto variances = noise_energies_sum_.array()/num_energy_timesteps;
+  bool degenerate = (variances < std::numeric_limits<double>::epsilon()).any();
+
+  for(auto r = 0u; r < num_noisy_rollouts; r++)
+  {
+    Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
+    if(r < num_new_rollouts)
     {
-      noisy_rollouts_[r].full_probabilities[d] = noisy_rollouts_[r].importance_weight *
-          exp(-h*(noisy_rollouts_[r].full_costs[d] - min_cost)/denom);
-      probl_sum += noisy_rollouts_[r].full_probabilities[d];
+      rollout.sampling_energies = energies.col(r);
+      rollout.sampling_scales = noise_scale_;
+      rollout.importance_weight = DEFAULT_NOISY_COST_IMPORTANCE_WEIGHT;
+      continue;
     }
-    for (int r=0; r<num_active_rollouts_; ++r)
+
+    if(degenerate)
     {
-        noisy_rollouts_[r].full_probabilities[d] /= probl_sum;
+      rollout.importance_weight = DEFAULT_NOISY_COST_IMPORTANCE_WEIGHT;
+      continue;
     }
+
+    // log of the density ratio, the normalization terms only differ when the noise scale has changed
+    double log_ratio = -config_.num_timesteps*(noise_scale_.array()/rollout.sampling_scales.array()).log().sum() -
+        0.5*((energies.col(r) - rollout.sampling_energies).array()/variances).sum();
+    rollout.importance_weight = std::min(std::exp(log_ratio),MAX_IMPORTANCE_WEIGHT);
   }
 
   return true;
 }
 
-bool Stomp::updateParameters()
+bool Stomp::computeProbabilities()
 {
-  // computing updates from probabilities using convex combination
-  parameters_updates_.setZero();
-  for(auto d = 0u; d < config_.num_dimensions ; d++)
+  const double h = config_.exponentiated_cost_sensitivity;
+  const int num_rollouts = num_active_rollouts_;
+  const int num_parameters = config_.num_dimensions*config_.num_timesteps;
+
+  /* gathering the costs of all rollouts into a matrix [dimensions x timesteps][rollouts], each column is a contiguous
+   * copy of a rollout's total costs so that all the reductions and element-wise operations below are vectorized.
+   */
+  auto costs = rollouts_costs_.leftCols(num_rollouts);
+  auto importance_weights = rollouts_weights_.head(num_rollouts);
+  for (auto r = 0u; r<num_rollouts; ++r)
   {
+    const Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
+    costs.col(r) = Eigen::VectorXd::Map(rollout.total_costs.data(),num_parameters);
+    importance_weights(r) = rollout.importance_weight;
+  }
 
-    for(auto r = 0u; r < num_active_rollouts_; r++)
+  // processing blocks of parameters so that the intermediate results remain in cache
+  auto all_probabilities = rollouts_probabilities_.leftCols(num_rollouts);
+  for(int start = 0; start < num_parameters; start += PROBABILITIES_BLOCK_SIZE)
+  {
+    int block_size = std::min(PROBABILITIES_BLOCK_SIZE,num_parameters - start);
+    auto block_costs = costs.middleRows(start,block_size);
+    auto probabilities = all_probabilities.middleRows(start,block_size);
+    auto min_costs = rollouts_min_costs_.segment(start,block_size);
+    auto scale = rollouts_cost_scale_.segment(start,block_size);
+
+    // find min and max cost over all rollouts for each parameter
+    min_costs = block_costs.rowwise().minCoeff();
+    scale = (block_costs.rowwise().maxCoeff() - min_costs).cwiseMax(MIN_COST_DIFFERENCE); // prevent division by zero
+    scale = -h*scale.cwiseInverse();
+
+    // this is the exponential term in the probability calculation described in the literature
+    probabilities.array() = ((block_costs.colwise() - min_costs).array().colwise() * scale.array()).exp();
+    for (auto r = 0u; r<num_rollouts; ++r)
     {
-      auto& rollout = noisy_rollouts_[r];
-      parameters_updates_.row(d) +=  (rollout.noise.row(d).array() * rollout.probabilities.row(d).array()).matrix();
+      probabilities.col(r) *= importance_weights(r);
     }
 
+    // scaling each probability value by the sum of all probabilities corresponding to all rollouts for that parameter
+    scale = probabilities.rowwise().sum().cwiseInverse();
+    probabilities.array().colwise() *= scale.array();
+  }
+
+  // computing full probabilities, these overwrite the gathered full costs
+  auto full_costs = rollouts_full_costs_.leftCols(num_rollouts);
+  for (auto r = 0u; r<num_rollouts; ++r)
+  {
+    full_costs.col(r) = Eigen::VectorXd::Map(noisy_rollouts_[rollout_indices_[r]].full_costs.data(),config_.num_dimensions);
+  }
+
+  for (auto d = 0u; d<config_.num_dimensions; ++d)
+  {
+    double min_cost = full_costs.row(d).minCoeff();
+    double denom = std::max(full_costs.row(d).maxCoeff() - min_cost,MIN_COST_DIFFERENCE);
+    full_costs.row(d) = (importance_weights.transpose().array() *
+        (-h*(full_costs.row(d).array() - min_cost)/denom).exp()).matrix();
+    full_costs.row(d) /= full_costs.row(d).sum();
+  }
+
+  for (auto r = 0u; r<num_rollouts; ++r)
+  {
+    Eigen::VectorXd::Map(noisy_rollouts_[rollout_indices_[r]].full_probabilities.data(),config_.num_dimensions) = full_costs.col(r);
+  }
+
+  return true;
+}
+
+bool Stomp::updateParameters()
+{
+  // computing updates from probabilities using convex combination
+  const int num_parameters = config_.num_dimensions*config_.num_timesteps;
+  Eigen::Map<Eigen::VectorXd> updates(parameters_updates_.data(),num_parameters);
+  updates.setZero();
+  for(auto r = 0u; r < num_active_rollouts_; r++)
+  {
+    const Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
+    updates += Eigen::VectorXd::Map(rollout.noise.data(),num_parameters).cwiseProduct(rollouts_probabilities_.col(r));
   }
 
   // filtering updates
-  if(!task_->filterParameterUpdates(0,config_.num_timesteps,current_iteration_,parameters_optimized_,parameters_updates_))
+  if(!task_->filterParameterUpdates(window_start_,window_timesteps_,current_iteration_,parameters_optimized_,parameters_updates_))
   {
     ROS_ERROR("Updates filtering step failed");
     return false;
   }
 
+  // the filters may spread the updates beyond the window
+  if(window_timesteps_ < config_.num_timesteps)
+  {
+    parameters_updates_.leftCols(window_start_ + 1).setZero();
+    parameters_updates_.rightCols(config_.num_timesteps - (window_start_ + window_timesteps_) + 1).setZero();
+  }
+
   // updating parameters
   parameters_optimized_ += parameters_updates_;
 
   return true;
 }
 
+bool Stomp::adaptNoise()
+{
+  if(config_.noise_adaptation_rate <= 0)
+  {
+    return true;
+  }
+
+  // the last active rollout holds the optimized parameters and carries no noise
+  const int num_noisy_rollouts = num_active_rollouts_ - 1;
+  if(num_noisy_rollouts < 1)
+  {
+    return true;
+  }
+
+  Eigen::VectorXd& sampled_moment = sampled_noise_moment_;
+  Eigen::VectorXd& weighted_moment = weighted_noise_moment_;
+  sampled_moment.setZero();
+  weighted_moment.setZero();
+  for(auto r = 0u; r < num_noisy_rollouts; r++)
+  {
+    const Rollout& rollout = noisy_rollouts_[rollout_indices_[r]];
+    Eigen::Map<const Eigen::MatrixXd> probabilities(rollouts_probabilities_.col(r).data(),
+                                                    config_.num_dimensions,config_.num_timesteps);
+    sampled_moment += rollout.noise.array().square().rowwise().sum().matrix();
+    weighted_moment += (rollout.noise.array().square()*probabilities.array()).rowwise().sum().matrix();
+  }
+  sampled_moment /= num_noisy_rollouts;
+
+  // blending the current variance with the variance of the successful rollouts
+  double rate = std::min(config_.noise_adaptation_rate,1.0);
+  for(auto d = 0u; d < config_.num_dimensions; d++)
+  {
+    if(sampled_moment(d) < std::numeric_limits<double>::epsilon())
+    {
+      continue;
+    }
+
+    double ratio = weighted_moment(d)/sampled_moment(d);
+    noise_scale_(d) *= std::sqrt((1.0 - rate) + rate*ratio);
+    noise_scale_(d) = std::max(config_.min_noise_scale,std::min(config_.max_noise_scale,noise_scale_(d)));
+  }
+
+  return true;
+}
+
 bool Stomp::computeOptimizedCost()
 {
 
@@ -764,11 +1471,11 @@ bool Stomp::computeOptimizedCost()
   parameters_total_cost_ = 0;
   if(config_.control_cost_weight > MIN_CONTROL_COST_WEIGHT)
   {
-    computeParametersControlCosts(parameters_optimized_,
-                                  config_.delta_t,
-                                  config_.control_cost_weight,
-                                  control_cost_matrix_R_,
-                                  parameters_control_costs_);
+    kernels_.computeControlCosts(parameters_optimized_,
+                                 config_.delta_t,
+                                 config_.control_cost_weight,
+                                 control_cost_matrices_->control_cost_matrix_R,
+                                 parameters_control_costs_);
 
     // adding all costs
     parameters_total_cost_ = parameters_control_costs_.rowwise().sum().sum();
@@ -776,7 +1483,21 @@ bool Stomp::computeOptimizedCost()
   }
 
   // state costs
-  if(task_->computeCosts(parameters_optimized_,
+  if(window_timesteps_ < config_.num_timesteps)
+  {
+    // only the window changes, the costs outside of it were computed when the optimization started
+    Eigen::VectorXd& window_costs = workspaces_[0].window_costs;
+    if(!task_->computeCosts(parameters_optimized_,
+                            window_start_,window_timesteps_,current_iteration_,window_costs,parameters_valid_))
+    {
+      return false;
+    }
+
+    parameters_state_costs_.segment(window_start_,window_timesteps_) = window_costs;
+    parameters_valid_ &= outside_window_valid_;
+    parameters_total_cost_ += parameters_state_costs_.sum();
+  }
+  else if(task_->computeCosts(parameters_optimized_,
                          0,config_.num_timesteps,current_iteration_,parameters_state_costs_,parameters_valid_))
   {
 
@@ -788,6 +1509,19 @@ bool Stomp::computeOptimizedCost()
     return false;
   }
 
+  // an invalid iterate may have lowered the cost below this one, so the valid solutions are tracked separately
+  if(parameters_valid_)
+  {
+    std::lock_guard<std::mutex> lock(best_solution_mutex_);
+    if(best_valid_cost_ > parameters_total_cost_)
+    {
+      best_solution_found_ = true;
+      best_parameters_ = parameters_optimized_;
+      best_valid_cost_ = parameters_total_cost_;
+      best_iteration_ = current_iteration_;
+    }
+  }
+
   if(current_lowest_cost_ > parameters_total_cost_)
   {
     current_lowest_cost_ = parameters_total_cost_;
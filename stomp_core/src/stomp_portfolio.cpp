@@ -0,0 +1,170 @@
+/**
+ * @file stomp_portfolio.cpp
+ * @brief This contains a solver that runs several stomp optimizations in parallel
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ros/console.h>
+#include <thread>
+#include <limits>
+#include "stomp_core/stomp_portfolio.h"
+
+namespace stomp_core
+{
+
+StompPortfolio::StompPortfolio(const std::vector<StompConfiguration>& configs,const std::vector<TaskPtr>& tasks)
+{
+  if(configs.size() != tasks.size())
+  {
+    ROS_ERROR("The portfolio requires one task per configuration, got %lu configurations and %lu tasks",
+              configs.size(),tasks.size());
+    return;
+  }
+
+  for(auto i = 0u; i < configs.size(); i++)
+  {
+    instances_.push_back(std::make_shared<Stomp>(configs[i],tasks[i]));
+  }
+}
+
+bool StompPortfolio::solve(const std::vector<double>& first,const std::vector<double>& last,
+                           Eigen::MatrixXd& parameters_optimized,int& instance)
+{
+  instance = -1;
+  int num_instances = instances_.size();
+  if(num_instances == 0)
+  {
+    ROS_ERROR("The portfolio has no Stomp instances");
+    return false;
+  }
+
+  std::vector<Eigen::MatrixXd> solutions(num_instances);
+  std::vector<StompStatistics> statistics(num_instances);
+  int winner = -1;
+
+  // clearing the instances while cancel() waits, a cancellation requested before this point is kept by 'cancelled_'
+  {
+    std::lock_guard<std::mutex> lock(result_mutex_);
+    for(auto& stomp : instances_)
+    {
+      stomp->clear();
+    }
+
+    if(cancelled_)
+    {
+      cancelled_ = false;
+      ROS_ERROR("STOMP portfolio was terminated");
+      return false;
+    }
+  }
+
+  auto run = [&](int i)
+  {
+    if(!instances_[i]->solve(first,last,solutions[i],&statistics[i]))
+    {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(result_mutex_);
+    if(winner < 0)
+    {
+      winner = i;
+      for(int j = 0; j < num_instances; j++)
+      {
+        if(j != i)
+        {
+          instances_[j]->cancel();
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_instances);
+  for(int i = 0; i < num_instances; i++)
+  {
+    threads.emplace_back(run,i);
+  }
+
+  for(auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(result_mutex_);
+    cancelled_ = false;
+  }
+
+  if(winner >= 0)
+  {
+    ROS_DEBUG("STOMP portfolio instance %i found the first valid solution",winner);
+    instance = winner;
+    parameters_optimized = solutions[winner];
+    return true;
+  }
+
+  // no valid solution, keeping the lowest cost one
+  double lowest_cost = std::numeric_limits<double>::max();
+  for(int i = 0; i < num_instances; i++)
+  {
+    if(statistics[i].cost_history.empty() || solutions[i].size() == 0)
+    {
+      continue;
+    }
+
+    if(statistics[i].cost_history.back() < lowest_cost)
+    {
+      lowest_cost = statistics[i].cost_history.back();
+      instance = i;
+    }
+  }
+
+  if(instance >= 0)
+  {
+    parameters_optimized = solutions[instance];
+  }
+
+  ROS_ERROR("STOMP portfolio failed to find a valid solution with %i instances",num_instances);
+  return false;
+}
+
+bool StompPortfolio::cancel()
+{
+  std::lock_guard<std::mutex> lock(result_mutex_);
+  cancelled_ = true;
+
+  bool cancelled = true;
+  for(auto& stomp : instances_)
+  {
+    cancelled &= stomp->cancel();
+  }
+  return cancelled;
+}
+
+std::size_t StompPortfolio::size() const
+{
+  return instances_.size();
+}
+
+} /* namespace stomp_core */
@@ -25,6 +25,7 @@
  */
 #include <stomp_core/utils.h>
 #include <cmath>
+#include <algorithm>
 #include <iostream>
 #include <Eigen/Dense>
 
@@ -61,6 +62,35 @@ void generateFiniteDifferenceMatrix(int num_time_steps,
   }
 }
 
+void generateFiniteDifferenceMatrix(int num_time_steps,
+                                    DerivativeOrders::DerivativeOrder order,
+                                    double dt, Eigen::SparseMatrix<double>& diff_matrix)
+{
+  std::vector<Eigen::Triplet<double> > coefficients;
+  coefficients.reserve(num_time_steps*FINITE_DIFF_RULE_LENGTH);
+  double multiplier = 1.0/pow(dt,(int)order);
+  for (int i=0; i<num_time_steps; ++i)
+  {
+    for (int j=-FINITE_DIFF_RULE_LENGTH/2; j<=FINITE_DIFF_RULE_LENGTH/2; ++j)
+    {
+      int index = i+j;
+      if (index < 0 || index >= num_time_steps)
+      {
+        continue;
+      }
+
+      double coeff = FINITE_CENTRAL_DIFF_COEFFS[order][j+FINITE_DIFF_RULE_LENGTH/2];
+      if(coeff != 0)
+      {
+        coefficients.push_back(Eigen::Triplet<double>(i,index,multiplier * coeff));
+      }
+    }
+  }
+
+  diff_matrix.resize(num_time_steps, num_time_steps);
+  diff_matrix.setFromTriplets(coefficients.begin(),coefficients.end());
+}
+
 void generateSmoothingMatrix(int num_timesteps,double dt, Eigen::MatrixXd& projection_matrix_M)
 {
   using namespace Eigen;
@@ -92,9 +122,87 @@ void generateSmoothingMatrix(int num_timesteps,double dt, Eigen::MatrixXd& proje
   }
 }
 
+void resampleParameters(const Eigen::MatrixXd& parameters, int num_timesteps, Eigen::MatrixXd& resampled)
+{
+  int num_points = parameters.cols();
+  resampled.resize(parameters.rows(),num_timesteps);
+
+  // tangents per unit of the source index, central differences inside and one sided at the ends
+  Eigen::MatrixXd tangents(parameters.rows(),num_points);
+  tangents.col(0) = parameters.col(1) - parameters.col(0);
+  tangents.col(num_points - 1) = parameters.col(num_points - 1) - parameters.col(num_points - 2);
+  for(auto i = 1; i < num_points - 1; i++)
+  {
+    tangents.col(i) = 0.5*(parameters.col(i + 1) - parameters.col(i - 1));
+  }
+
+  double scale = num_timesteps > 1 ? double(num_points - 1)/(num_timesteps - 1) : 0;
+  for(auto t = 0; t < num_timesteps; t++)
+  {
+    double x = t*scale;
+    int i = std::min(int(x),num_points - 2);
+    double s = x - i;
+    double s2 = s*s;
+    double s3 = s2*s;
+
+    // cubic hermite basis
+    double h00 = 2*s3 - 3*s2 + 1;
+    double h10 = s3 - 2*s2 + s;
+    double h01 = -2*s3 + 3*s2;
+    double h11 = s3 - s2;
+
+    resampled.col(t) = h00*parameters.col(i) + h10*tangents.col(i) + h01*parameters.col(i + 1) + h11*tangents.col(i + 1);
+  }
+
+  // removing round off at the end points
+  resampled.col(0) = parameters.col(0);
+  resampled.col(num_timesteps - 1) = parameters.col(num_points - 1);
+}
+
 void differentiate(const Eigen::VectorXd& parameters, DerivativeOrders::DerivativeOrder order,
                           double dt, Eigen::VectorXd& derivatives )
 {
+  const double* central_coeffs = FINITE_CENTRAL_DIFF_COEFFS[order];
+  const double* forward_coeffs = FINITE_FORWARD_DIFF_COEFFS[order];
+  double backward_sign = (order % 2 != 0) ? -1.0 : 1.0;  // the backward rule is the reversed forward rule
+
+  int rule_length = FINITE_DIFF_RULE_LENGTH;
+  int size = parameters.size();
+  int skip = FINITE_DIFF_RULE_LENGTH/2;
+  double multiplier = 1.0/std::pow(dt,2);
+  derivatives.resize(size);
+  for(auto i = 0; i < size; i++)
+  {
+    double derivative = 0;
+    if(i < skip)
+    {
+      for(auto j = 0; j < rule_length; j++)
+      {
+        derivative += forward_coeffs[j]*parameters(i + j);
+      }
+    }
+    else if(i < size - skip)
+    {
+      for(auto j = 0; j < rule_length; j++)
+      {
+        derivative += central_coeffs[j]*parameters(i - skip + j);
+      }
+    }
+    else
+    {
+      for(auto j = 0; j < rule_length; j++)
+      {
+        derivative += backward_sign*forward_coeffs[rule_length - 1 - j]*parameters(i - rule_length + 1 + j);
+      }
+    }
+
+    derivatives(i) = multiplier*derivative;
+  }
+}
+
+void differentiateDense(const Eigen::VectorXd& parameters, DerivativeOrders::DerivativeOrder order,
+                        double dt, Eigen::VectorXd& derivatives)
+{
 
   using namespace Eigen;
 
@@ -140,6 +248,51 @@ void differentiate(const Eigen::VectorXd& parameters, DerivativeOrders::Derivati
   derivatives = A*parameters/std::pow(dt,2);
 }
 
+void computeControlCosts(const Eigen::MatrixXd& parameters, double dt, Eigen::VectorXd& costs)
+{
+  const double* coeffs = FINITE_CENTRAL_DIFF_COEFFS[DerivativeOrders::STOMP_ACCELERATION];
+  int num_timesteps = parameters.cols();
+  int half = FINITE_DIFF_RULE_LENGTH/2;
+  double multiplier = 1.0/std::pow(dt,2);
+
+  // x * R * x_transpose = dt*|A*x|^2, the accelerations reach 'half' timesteps into the zero padding at each end
+  costs.resize(parameters.rows());
+  for(auto d = 0; d < parameters.rows(); d++)
+  {
+    double cost = 0;
+    for(auto t = -half; t < num_timesteps + half; t++)
+    {
+      int first = std::max(t - half,0);
+      int last = std::min(t + half,num_timesteps - 1);
+      double acceleration = 0;
+      for(auto j = first; j <= last; j++)
+      {
+        acceleration += coeffs[j - t + half]*parameters(d,j);
+      }
+      cost += acceleration*acceleration;
+    }
+    costs(d) = dt*multiplier*multiplier*cost;
+  }
+}
+
+void computeControlCostsDense(const Eigen::MatrixXd& parameters, double dt, Eigen::VectorXd& costs)
+{
+  int start_index_padded = FINITE_DIFF_RULE_LENGTH - 1;
+  int num_timesteps = parameters.cols();
+  Eigen::MatrixXd finite_diff_matrix_A_padded;
+  generateFiniteDifferenceMatrix(num_timesteps + 2*start_index_padded,DerivativeOrders::STOMP_ACCELERATION,
+                                 dt,finite_diff_matrix_A_padded);
+
+  Eigen::MatrixXd control_cost_matrix_R = (dt*finite_diff_matrix_A_padded.transpose()*finite_diff_matrix_A_padded).block(
+      start_index_padded,start_index_padded,num_timesteps,num_timesteps);
+
+  costs.resize(parameters.rows());
+  for(auto d = 0; d < parameters.rows(); d++)
+  {
+    costs(d) = parameters.row(d).dot(control_cost_matrix_R*parameters.row(d).transpose());
+  }
+}
+
 void toVector(const Eigen::MatrixXd& m,std::vector<Eigen::VectorXd>& v)
 {
   v.resize(m.rows(),Eigen::VectorXd::Zero(m.cols()));
@@ -179,9 +332,20 @@ std::string toString(const Eigen::VectorXd& data)
   return ss.str();
 }
 
+std::string toString(const StompStatistics& statistics)
+{
+  std::stringstream ss;
+  ss<<"iterations: "<<statistics.iterations<<", rollouts evaluated: "<<statistics.rollouts_evaluated
+      <<", rollouts reused: "<<statistics.rollouts_reused<<", threads: "<<statistics.threads<<"\n";
+  ss<<"noise generation: "<<statistics.noise_generation_time<<" s\n";
+  ss<<"noisy filters: "<<statistics.noisy_filters_time<<" s\n";
+  ss<<"state costs: "<<statistics.state_costs_time<<" s\n";
+  ss<<"control costs: "<<statistics.control_costs_time<<" s\n";
+  ss<<"probabilities: "<<statistics.probabilities_time<<" s\n";
+  ss<<"update filters: "<<statistics.update_filters_time<<" s\n";
+  ss<<"optimized cost: "<<statistics.optimized_cost_time<<" s\n";
+  ss<<"total: "<<statistics.total_time<<" s";
+  return ss.str();
 }
 
-
-
-
-
+}
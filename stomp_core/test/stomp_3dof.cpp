@@ -24,11 +24,53 @@
  * limitations under the License.
  */
 #include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <set>
 #include <Eigen/Dense>
 #include <gtest/gtest.h>
 #include "stomp_core/stomp.h"
+#include "stomp_core/stomp_portfolio.h"
+#include "stomp_core/stomp_kernels.h"
+#include "stomp_core/matrix_cache.h"
+#include "stomp_core/random_stream.h"
 #include "stomp_core/task.h"
 
+#ifdef __GLIBC__
+/** @brief The number of heap allocations made by the process, counted by the wrappers of the glibc allocator below */
+static std::atomic<long> NUM_ALLOCATIONS(0);
+
+extern "C"
+{
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t num,std::size_t size);
+void* __libc_realloc(void* ptr,std::size_t size);
+
+/** @brief Counts the allocation, operator new and the Eigen allocations also end up here */
+void* malloc(std::size_t size)
+{
+  NUM_ALLOCATIONS++;
+  return __libc_malloc(size);
+}
+
+/** @brief Counts the allocation */
+void* calloc(std::size_t num,std::size_t size)
+{
+  NUM_ALLOCATIONS++;
+  return __libc_calloc(num,size);
+}
+
+/** @brief Counts the allocation */
+void* realloc(void* ptr,std::size_t size)
+{
+  NUM_ALLOCATIONS++;
+  return __libc_realloc(ptr,size);
+}
+}
+#endif
+
 using Trajectory = Eigen::MatrixXd;                              /**< Assign Type Trajectory to Eigen::MatrixXd Type */
 
 const std::size_t NUM_DIMENSIONS = 3;                            /**< Number of parameters to optimize */
@@ -121,7 +163,7 @@ public:
       for(std::size_t d = 0u; d < parameters.rows() ; d++)
       {
 
-        diff = std::abs(parameters(d,t) - parameters_bias_(d,t));
+        diff = std::abs(parameters(d,start_timestep + t) - parameters_bias_(d,start_timestep + t));
         if( diff > std::abs(bias_thresholds_[d]))
         {
           cost += diff;
@@ -164,7 +206,8 @@ protected:
 
     for(auto d = 0u; d < updates.rows(); d++)
     {
-      updates.row(d).transpose() = smoothing_M_*(updates.row(d).transpose());
+      smoothed_updates_.noalias() = smoothing_M_*(updates.row(d).transpose());
+      updates.row(d) = smoothed_updates_.transpose();
     }
 
     return true;
@@ -176,6 +219,261 @@ protected:
   std::vector<double> bias_thresholds_; /**< Threshold to determine whether two trajectories are equal */
   std::vector<double> std_dev_;         /**< Standard deviation used for generating noisy parameters */
   Eigen::MatrixXd smoothing_M_;         /**< Matrix used for smoothing the trajectory */
+  Eigen::VectorXd smoothed_updates_;    /**< The smoothed updates of a dimension */
+};
+
+/** @brief A dummy task whose bias can be changed between optimizations */
+class MovableDummyTask: public DummyTask
+{
+public:
+  using DummyTask::DummyTask;
+
+  /**
+   * @brief Offsets the bias over a range of timesteps
+   * @param start_timestep first timestep to offset
+   * @param num_timesteps number of timesteps to offset
+   * @param offset value added to the bias of every dimension
+   */
+  void moveBias(int start_timestep,int num_timesteps,double offset)
+  {
+    parameters_bias_.middleCols(start_timestep,num_timesteps).array() += offset;
+  }
+
+  const Trajectory& getBias() const
+  {
+    return parameters_bias_;
+  }
+};
+
+/** @brief A dummy task that records the range of timesteps evaluated for the noisy rollouts */
+class RangeRecordingDummyTask: public DummyTask
+{
+public:
+  using DummyTask::DummyTask;
+
+  bool computeNoisyCosts(const Trajectory& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         int rollout_number,
+                         Eigen::VectorXd& costs,
+                         bool& validity) override
+  {
+    if(rollout_number >= 0)
+    {
+      ranges_.insert(std::make_pair(start_timestep,num_timesteps));
+    }
+    return DummyTask::computeNoisyCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,
+                                        costs,validity);
+  }
+
+  std::set<std::pair<std::size_t,std::size_t> > ranges_; /**< The distinct ranges of timesteps evaluated for the rollouts */
+};
+
+#ifdef __GLIBC__
+/** @brief A dummy task that records the largest number of heap allocations made during an iteration */
+class AllocationCountingTask: public DummyTask
+{
+public:
+  using DummyTask::DummyTask;
+
+  bool isThreadSafe() const override
+  {
+    return true;
+  }
+
+  void postIteration(std::size_t start_timestep,
+                     std::size_t num_timesteps,int iteration_number,double cost,const Eigen::MatrixXd& parameters) override
+  {
+    long num_allocations = NUM_ALLOCATIONS;
+
+    // the first iteration starts the worker threads
+    if(iteration_number > 1)
+    {
+      max_iteration_allocations_ = std::max(max_iteration_allocations_,num_allocations - last_num_allocations_);
+      num_counted_iterations_++;
+    }
+    last_num_allocations_ = num_allocations;
+  }
+
+  long max_iteration_allocations_ = 0;  /**< The largest number of allocations made by an iteration */
+  int num_counted_iterations_ = 0;      /**< The number of iterations counted */
+
+protected:
+  long last_num_allocations_ = 0;       /**< The number of allocations at the end of the previous iteration */
+};
+#endif
+
+/** @brief A dummy task that allows Stomp to evaluate its rollouts from multiple threads */
+class ThreadSafeDummyTask: public DummyTask
+{
+public:
+  using DummyTask::DummyTask;
+
+  bool isThreadSafe() const override
+  {
+    return true;
+  }
+};
+
+/** @brief A dummy task that counts the copies made for the worker threads */
+class CloningDummyTask: public DummyTask
+{
+public:
+  using DummyTask::DummyTask;
+
+  TaskPtr clone() const override
+  {
+    num_clones_++;
+    return TaskPtr(new DummyTask(*this));
+  }
+
+  bool updateClone(Task& clone) const override
+  {
+    num_updates_++;
+    return true;
+  }
+
+  mutable int num_clones_ = 0;      /**< The number of copies made */
+  mutable int num_updates_ = 0;     /**< The number of copies brought up to date */
+};
+
+/** @brief A thread safe dummy task that draws the noise of each rollout from its own random stream */
+class StreamDummyTask: public ThreadSafeDummyTask
+{
+public:
+  StreamDummyTask(const Trajectory& parameters_bias,
+                  const std::vector<double>& bias_thresholds,
+                  const std::vector<double>& std_dev,
+                  std::uint64_t seed):
+    ThreadSafeDummyTask(parameters_bias,bias_thresholds,std_dev),
+    seed_(seed)
+  {
+
+  }
+
+  bool generateNoisyParameters(const Eigen::MatrixXd& parameters,
+                               std::size_t start_timestep,
+                               std::size_t num_timesteps,
+                               int iteration_number,
+                               int rollout_number,
+                               Eigen::MatrixXd& parameters_noise,
+                               Eigen::MatrixXd& noise) override
+  {
+    RandomStream stream;
+    for(std::size_t d = 0; d < parameters.rows(); d++)
+    {
+      stream.reset(seed_,iteration_number,rollout_number,d);
+      for(std::size_t t = 0; t < parameters.cols(); t++)
+      {
+        noise(d,t) = stream.nextUniform(-1,1)*std_dev_[d];
+      }
+    }
+
+    parameters_noise = parameters + noise;
+
+    return true;
+  }
+
+protected:
+  std::uint64_t seed_;        /**< The seed of the random streams */
+};
+
+/** @brief A seeded dummy task whose valid trajectories also cost their squared distance to the bias */
+class GradedDummyTask: public StreamDummyTask
+{
+public:
+  using StreamDummyTask::StreamDummyTask;
+
+  bool computeNoisyCosts(const Trajectory& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         int rollout_number,
+                         Eigen::VectorXd& costs,
+                         bool& validity) override
+  {
+    StreamDummyTask::computeNoisyCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,
+                                       costs,validity);
+    for(std::size_t t = 0u; t < num_timesteps; t++)
+    {
+      costs(t) = (parameters.col(start_timestep + t) - parameters_bias_.col(start_timestep + t)).squaredNorm();
+    }
+
+    return true;
+  }
+};
+
+/** @brief A dummy task with an expensive cost function */
+class SlowDummyTask: public DummyTask
+{
+public:
+  using DummyTask::DummyTask;
+
+  bool computeNoisyCosts(const Trajectory& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         int rollout_number,
+                         Eigen::VectorXd& costs,
+                         bool& validity) override
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    return DummyTask::computeNoisyCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,
+                                        costs,validity);
+  }
+};
+
+/** @brief A dummy task that can evaluate a different number of timesteps by resampling its bias */
+class ResizableDummyTask: public DummyTask
+{
+public:
+  ResizableDummyTask(const Trajectory& parameters_bias,
+                     const std::vector<double>& bias_thresholds,
+                     const std::vector<double>& std_dev):
+                       DummyTask(parameters_bias,bias_thresholds,std_dev),
+                       full_parameters_bias_(parameters_bias)
+  {
+
+  }
+
+  bool setNumTimesteps(int num_timesteps) override
+  {
+    requested_timesteps_.push_back(num_timesteps);
+    resampleParameters(full_parameters_bias_,num_timesteps,parameters_bias_);
+    generateSmoothingMatrix(num_timesteps,1.0,smoothing_M_);
+    return true;
+  }
+
+  Trajectory full_parameters_bias_;         /**< The parameter bias at the full number of timesteps */
+  std::vector<int> requested_timesteps_;    /**< The number of timesteps requested by Stomp in order */
+};
+
+/** @brief A dummy task that evaluates all the rollouts of an iteration in a single call */
+class BatchDummyTask: public DummyTask
+{
+public:
+  using DummyTask::DummyTask;
+
+  bool hasBatchCosts() const override
+  {
+    return true;
+  }
+
+  bool computeNoisyCostsBatch(const std::vector<const Eigen::MatrixXd*>& parameters,
+                              std::size_t start_timestep,
+                              std::size_t num_timesteps,
+                              int iteration_number,
+                              const std::vector<int>& rollout_numbers,
+                              const std::vector<Eigen::VectorXd*>& costs,
+                              bool& validity) override
+  {
+    batch_sizes_.push_back(parameters.size());
+    return Task::computeNoisyCostsBatch(parameters,start_timestep,num_timesteps,iteration_number,rollout_numbers,
+                                        costs,validity);
+  }
+
+  std::vector<std::size_t> batch_sizes_; /**< The number of rollouts passed to each batched call */
 };
 
 /**
@@ -374,6 +672,34 @@ TEST(Stomp3DOF,solve_min_control_cost_initial)
   std::cout<<"Differences"<<"\n"<<toString(diff)<<line_separator;
 }
 
+/** @brief This tests the minimum control cost initial trajectory on a long trajectory */
+TEST(Stomp3DOF,min_control_cost_initial_500_timesteps)
+{
+  int num_timesteps = 500;
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,num_timesteps,trajectory_bias);
+  TaskPtr task(new DummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.initialization_method = TrajectoryInitializations::MININUM_CONTROL_COST;
+  config.num_timesteps = num_timesteps;
+  config.num_iterations = 0;
+  Stomp stomp(config,task);
+
+  Trajectory initial;
+  stomp.solve(START_POS,END_POS,initial);
+
+  EXPECT_EQ(initial.rows(),NUM_DIMENSIONS);
+  EXPECT_EQ(initial.cols(),num_timesteps);
+  for(auto d = 0u; d < NUM_DIMENSIONS; d++)
+  {
+    EXPECT_DOUBLE_EQ(initial(d,0),START_POS[d]);
+    EXPECT_DOUBLE_EQ(initial(d,num_timesteps - 1),END_POS[d]);
+    EXPECT_LE(initial.row(d).maxCoeff(),std::max(START_POS[d],END_POS[d]) + 1e-6);
+    EXPECT_GE(initial.row(d).minCoeff(),std::min(START_POS[d],END_POS[d]) - 1e-6);
+  }
+}
+
 /** @brief This tests Stomp solve method given 40 timesteps */
 TEST(Stomp3DOF,solve_40_timesteps)
 {
@@ -440,3 +766,697 @@ TEST(Stomp3DOF,solve_60_timesteps)
   std::cout<<"Differences"<<"\n"<<toString(diff)<<line_separator;
 }
 
+/** @brief This tests the Stomp solve method when rollouts from previous iterations are reused */
+TEST(Stomp3DOF,solve_reused_rollouts)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  TaskPtr task(new DummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_rollouts = 10;
+  config.max_rollouts = 40;
+  config.num_iterations = 100;
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  stomp.solve(START_POS,END_POS,optimized);
+
+  EXPECT_EQ(optimized.rows(),NUM_DIMENSIONS);
+  EXPECT_EQ(optimized.cols(),NUM_TIMESTEPS);
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+}
+
+/** @brief This tests that the parallel evaluation of the rollouts yields the same solution as the serial one */
+TEST(Stomp3DOF,solve_parallel_rollouts)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+
+  // serial evaluation
+  TaskPtr serial_task(new DummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  StompConfiguration config = create3DOFConfiguration();
+  Stomp serial_stomp(config,serial_task);
+
+  Trajectory serial_optimized;
+  StompStatistics statistics;
+  serial_stomp.solve(START_POS,END_POS,serial_optimized,&statistics);
+  EXPECT_EQ(statistics.threads,1);
+
+  // parallel evaluation, the task constructor resets the random seed
+  TaskPtr parallel_task(new ThreadSafeDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  config.num_threads = 4;
+  Stomp parallel_stomp(config,parallel_task);
+
+  Trajectory parallel_optimized;
+  parallel_stomp.solve(START_POS,END_POS,parallel_optimized,&statistics);
+  EXPECT_EQ(statistics.threads,4);
+
+  EXPECT_EQ(parallel_optimized.rows(),NUM_DIMENSIONS);
+  EXPECT_EQ(parallel_optimized.cols(),NUM_TIMESTEPS);
+  EXPECT_TRUE(compareDiff(parallel_optimized,trajectory_bias,BIAS_THRESHOLD));
+  EXPECT_TRUE(serial_optimized == parallel_optimized);
+}
+
+/** @brief This tests that the worker tasks are cloned once and reused by the following optimizations */
+TEST(Stomp3DOF,solve_reused_worker_tasks)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+
+  boost::shared_ptr<CloningDummyTask> task(new CloningDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_threads = 3;
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  StompStatistics statistics;
+  stomp.solve(START_POS,END_POS,optimized,&statistics);
+  EXPECT_EQ(statistics.threads,3);
+  EXPECT_EQ(task->num_clones_,3);
+  EXPECT_EQ(task->num_updates_,0);
+
+  stomp.solve(START_POS,END_POS,optimized,&statistics);
+  EXPECT_EQ(statistics.threads,3);
+  EXPECT_EQ(task->num_clones_,3);
+  EXPECT_EQ(task->num_updates_,3);
+
+  // a worker added by a new configuration is the only one cloned
+  config.num_threads = 4;
+  stomp.setConfig(config);
+  stomp.solve(START_POS,END_POS,optimized,&statistics);
+  EXPECT_EQ(statistics.threads,4);
+  EXPECT_EQ(task->num_clones_,4);
+  EXPECT_EQ(task->num_updates_,6);
+}
+
+/** @brief This tests the statistics reported by the Stomp solve method */
+TEST(Stomp3DOF,solve_statistics)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  TaskPtr task(new DummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_rollouts = 10;
+  config.max_rollouts = 30;
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  StompStatistics statistics;
+  stomp.solve(START_POS,END_POS,optimized,&statistics);
+
+  EXPECT_GT(statistics.iterations,0);
+  EXPECT_EQ(statistics.cost_history.size(),statistics.iterations);
+  EXPECT_EQ(statistics.rollouts_evaluated,statistics.iterations*config.num_rollouts);
+  EXPECT_GT(statistics.rollouts_reused,0);
+  EXPECT_GT(statistics.total_time,0);
+
+  double phases_time = statistics.noise_generation_time + statistics.noisy_filters_time + statistics.state_costs_time +
+      statistics.control_costs_time + statistics.probabilities_time + statistics.update_filters_time +
+      statistics.optimized_cost_time;
+  EXPECT_GT(phases_time,0);
+  EXPECT_LE(phases_time,statistics.total_time);
+}
+
+/** @brief This tests that Stomp stops once the cost stops improving */
+TEST(Stomp3DOF,solve_convergence)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  TaskPtr task(new DummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 500;
+  config.num_iterations_after_valid = 500;
+  config.convergence_iterations = 5;
+  config.convergence_threshold = 1e-3;
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  StompStatistics statistics;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized,&statistics));
+  EXPECT_LT(statistics.iterations,config.num_iterations);
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+}
+
+/** @brief This tests that Stomp stops as soon as a valid solution reaches the cost target */
+TEST(Stomp3DOF,solve_cost_target)
+{
+  // the initial trajectory is valid but away from the bias
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  for(auto t = 0u; t < NUM_TIMESTEPS; t++)
+  {
+    trajectory_bias.col(t).array() += 0.04*std::sin(M_PI*t/(NUM_TIMESTEPS - 1));
+  }
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 100;
+  config.num_iterations_after_valid = 100;
+
+  // the seeded noise makes both solves follow the same iterates
+  TaskPtr reference_task(new GradedDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV,7));
+  Stomp reference_stomp(config,reference_task);
+  Trajectory optimized;
+  StompStatistics reference;
+  reference_stomp.solve(START_POS,END_POS,optimized,&reference); // only its cost history is of interest
+  ASSERT_EQ(reference.iterations,config.num_iterations);
+  ASSERT_GT(reference.cost_history.front(),reference.cost_history.back());
+
+  config.cost_target = 0.5*(reference.cost_history.front() + reference.cost_history.back());
+  TaskPtr task(new GradedDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV,7));
+  Stomp stomp(config,task);
+  StompStatistics statistics;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized,&statistics));
+  EXPECT_GT(statistics.iterations,1);
+  EXPECT_LT(statistics.iterations,reference.iterations);
+  EXPECT_LE(statistics.cost_history.back(),config.cost_target);
+  for(auto i = 0u; i < statistics.cost_history.size(); i++)
+  {
+    EXPECT_EQ(statistics.cost_history[i],reference.cost_history[i]);
+  }
+}
+
+/** @brief This tests that Stomp stops when the allowed time elapses */
+TEST(Stomp3DOF,solve_deadline)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  TaskPtr task(new SlowDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 500;
+  config.num_iterations_after_valid = 500;
+  config.max_solve_time = 0.1;
+  Stomp stomp(config,task);
+
+  // every rollout takes at least 2 ms so an iteration takes at least 'num_rollouts' x 2 ms
+  Trajectory optimized;
+  StompStatistics statistics;
+  stomp.solve(START_POS,END_POS,optimized,&statistics);
+  EXPECT_LE(statistics.iterations,static_cast<int>(config.max_solve_time/(0.002*config.num_rollouts)));
+  EXPECT_GE(statistics.total_time,config.max_solve_time);
+
+  // a deadline that has passed before the first iteration
+  config.max_solve_time = 1e-9;
+  Stomp expired_stomp(config,task);
+  expired_stomp.solve(START_POS,END_POS,optimized,&statistics);
+  EXPECT_EQ(statistics.iterations,0);
+}
+
+/** @brief This tests the Stomp solve method seeded from a coarse optimization */
+TEST(Stomp3DOF,solve_coarse_to_fine)
+{
+  int num_timesteps = 60;
+  int num_coarse_timesteps = 15;
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,num_timesteps,trajectory_bias);
+  boost::shared_ptr<ResizableDummyTask> task(new ResizableDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_timesteps = num_timesteps;
+  config.num_coarse_timesteps = num_coarse_timesteps;
+  config.num_coarse_iterations = 10;
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_EQ(optimized.cols(),num_timesteps);
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+
+  std::vector<int> expected_timesteps = {num_coarse_timesteps,num_timesteps};
+  EXPECT_EQ(task->requested_timesteps_,expected_timesteps);
+
+  // a task that can not change its number of timesteps falls back to the plain initialization
+  TaskPtr fixed_task(new DummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  Stomp fixed_stomp(config,fixed_task);
+  EXPECT_TRUE(fixed_stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+}
+
+/** @brief This tests the Stomp solve method with a task that evaluates the rollouts in batches */
+TEST(Stomp3DOF,solve_batch_costs)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  boost::shared_ptr<BatchDummyTask> task(new BatchDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+
+  ASSERT_FALSE(task->batch_sizes_.empty());
+  for(auto batch_size : task->batch_sizes_)
+  {
+    EXPECT_EQ(batch_size,config.num_rollouts);
+  }
+}
+
+/** @brief This tests the Stomp solve method with a badly tuned noise magnitude that is adapted during the optimization */
+TEST(Stomp3DOF,solve_noise_adaptation)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  std::vector<double> std_dev = {6.0, 6.0, 6.0};
+  TaskPtr task(new DummyTask(trajectory_bias,BIAS_THRESHOLD,std_dev));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 200;
+  config.noise_adaptation_rate = 1.0;
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  StompStatistics statistics;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized,&statistics));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+  EXPECT_LT(statistics.iterations,config.num_iterations);
+}
+
+/** @brief This tests the Stomp solve method with a rollout pool much larger than the number of new rollouts */
+TEST(Stomp3DOF,solve_large_reuse_pool)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  TaskPtr task(new DummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 200;
+  config.num_rollouts = 5;
+  config.max_rollouts = 40;
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  StompStatistics statistics;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized,&statistics));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+  EXPECT_GT(statistics.rollouts_reused,0);
+}
+
+/** @brief This tests the Stomp solve method when the reused rollouts are weighted by their sampling density ratio */
+TEST(Stomp3DOF,solve_reweight_reused_rollouts)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  TaskPtr task(new DummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 200;
+  config.num_rollouts = 5;
+  config.max_rollouts = 40;
+  config.reweight_reused_rollouts = true;
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  StompStatistics statistics;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized,&statistics));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+  EXPECT_GT(statistics.rollouts_reused,0);
+}
+
+/** @brief This tests resuming the optimization after a change in the task */
+TEST(Stomp3DOF,resume_after_task_change)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  boost::shared_ptr<MovableDummyTask> task(new MovableDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.max_rollouts = 30;
+  Stomp stomp(config,task);
+
+  // nothing to resume from yet
+  Trajectory optimized;
+  EXPECT_FALSE(stomp.resume(optimized));
+
+  ASSERT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+
+  // changing the costs over part of the trajectory
+  int affected_start = 8;
+  int affected_timesteps = 4;
+  task->moveBias(affected_start,affected_timesteps,0.02);
+
+  StompStatistics statistics;
+  EXPECT_TRUE(stomp.resume(optimized,&statistics,affected_start,affected_timesteps));
+  EXPECT_EQ(optimized.cols(),NUM_TIMESTEPS);
+  EXPECT_TRUE(compareDiff(optimized,task->getBias(),BIAS_THRESHOLD));
+
+  EXPECT_FALSE(stomp.resume(optimized,nullptr,NUM_TIMESTEPS - 2,4));
+}
+
+/** @brief This tests reading the best solution while the optimization is in progress */
+TEST(Stomp3DOF,best_solution_while_solving)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  TaskPtr task(new SlowDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 1000;
+  config.num_iterations_after_valid = 1000;
+  Stomp stomp(config,task);
+
+  Trajectory best;
+  double cost;
+  int iteration;
+  EXPECT_FALSE(stomp.getBestSolution(best,cost,iteration));
+
+  Trajectory optimized;
+  std::thread solver([&](){ stomp.solve(START_POS,END_POS,optimized); });
+
+  // the linear initial trajectory is already valid
+  bool found = false;
+  for(int i = 0; i < 1000 && !found; i++)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    found = stomp.getBestSolution(best,cost,iteration);
+  }
+  stomp.cancel();
+  solver.join();
+
+  ASSERT_TRUE(found);
+  EXPECT_TRUE(compareDiff(best,trajectory_bias,BIAS_THRESHOLD));
+  EXPECT_GE(iteration,0);
+  EXPECT_LT(iteration,config.num_iterations);
+}
+
+/** @brief This tests the portfolio solver with a different initialization method on each instance */
+TEST(Stomp3DOF,portfolio_solve)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+
+  std::vector<int> methods = {TrajectoryInitializations::LINEAR_INTERPOLATION,
+                              TrajectoryInitializations::CUBIC_POLYNOMIAL_INTERPOLATION,
+                              TrajectoryInitializations::MININUM_CONTROL_COST};
+  std::vector<StompConfiguration> configs;
+  std::vector<TaskPtr> tasks;
+  for(auto method : methods)
+  {
+    StompConfiguration config = create3DOFConfiguration();
+    config.initialization_method = method;
+    configs.push_back(config);
+    tasks.push_back(TaskPtr(new DummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV)));
+  }
+
+  StompPortfolio portfolio(configs,tasks);
+  EXPECT_EQ(portfolio.size(),methods.size());
+
+  Trajectory optimized;
+  int instance;
+  EXPECT_TRUE(portfolio.solve(START_POS,END_POS,optimized,instance));
+  EXPECT_GE(instance,0);
+  EXPECT_LT(instance,methods.size());
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+
+  // a cancellation requested before the solve starts is not cleared by it, and only applies to that solve
+  EXPECT_TRUE(portfolio.cancel());
+  EXPECT_FALSE(portfolio.solve(START_POS,END_POS,optimized,instance));
+  EXPECT_EQ(instance,-1);
+  EXPECT_TRUE(portfolio.solve(START_POS,END_POS,optimized,instance));
+
+  // unreachable thresholds, the lowest cost solution is returned
+  std::vector<double> zero_thresholds(NUM_DIMENSIONS,0.0);
+  for(auto& config : configs)
+  {
+    config.num_iterations = 5;
+  }
+  tasks.clear();
+  for(auto i = 0u; i < configs.size(); i++)
+  {
+    tasks.push_back(TaskPtr(new DummyTask(trajectory_bias + Trajectory::Constant(NUM_DIMENSIONS,NUM_TIMESTEPS,0.1),
+                                          zero_thresholds,STD_DEV)));
+  }
+
+  StompPortfolio failing_portfolio(configs,tasks);
+  EXPECT_FALSE(failing_portfolio.solve(START_POS,END_POS,optimized,instance));
+  EXPECT_GE(instance,0);
+  EXPECT_EQ(optimized.cols(),NUM_TIMESTEPS);
+}
+
+/** @brief This tests re-optimizing a window of the trajectory while keeping the rest fixed */
+TEST(Stomp3DOF,solve_window)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  boost::shared_ptr<RangeRecordingDummyTask> task(new RangeRecordingDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  // perturbing the interior of the window only
+  int start_timestep = 5;
+  int num_timesteps = 10;
+  Trajectory initial = trajectory_bias;
+  initial.middleCols(start_timestep + 1,num_timesteps - 2).array() += 0.1;
+
+  StompConfiguration config = create3DOFConfiguration();
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solveWindow(initial,start_timestep,num_timesteps,optimized));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+
+  // the fixed sections are untouched
+  EXPECT_TRUE(optimized.leftCols(start_timestep + 1).isApprox(initial.leftCols(start_timestep + 1)));
+  int num_fixed_after = NUM_TIMESTEPS - (start_timestep + num_timesteps) + 1;
+  EXPECT_TRUE(optimized.rightCols(num_fixed_after).isApprox(initial.rightCols(num_fixed_after)));
+
+  // the noisy rollouts are only evaluated inside the window
+  ASSERT_EQ(task->ranges_.size(),1);
+  EXPECT_EQ(task->ranges_.begin()->first,start_timestep);
+  EXPECT_EQ(task->ranges_.begin()->second,num_timesteps);
+
+  EXPECT_FALSE(stomp.solveWindow(initial,NUM_TIMESTEPS - 2,num_timesteps,optimized));
+}
+
+/** @brief This tests that the computations specialized for a fixed number of dimensions match the dynamic ones */
+TEST(Stomp3DOF,fixed_dimension_kernels)
+{
+  using namespace stomp_core;
+
+  const double control_cost_weight = 0.5;
+  Eigen::SparseMatrix<double> R;
+  generateFiniteDifferenceMatrix(NUM_TIMESTEPS,DerivativeOrders::STOMP_ACCELERATION,DELTA_T,R);
+  R = R.transpose()*R;
+
+  Trajectory x = Trajectory::Random(NUM_DIMENSIONS,NUM_TIMESTEPS);
+  Eigen::VectorXd fixed_costs(NUM_DIMENSIONS), dynamic_costs(NUM_DIMENSIONS);
+  StompKernels<NUM_DIMENSIONS>::computeQuadraticCosts(x,R,fixed_costs.data());
+  StompKernels<Eigen::Dynamic>::computeQuadraticCosts(x,R,dynamic_costs.data());
+  Eigen::VectorXd expected_costs = (x*Eigen::MatrixXd(R)*x.transpose()).diagonal();
+  EXPECT_TRUE(fixed_costs.isApprox(expected_costs));
+  EXPECT_TRUE(dynamic_costs.isApprox(expected_costs));
+
+  Rollout fixed_rollout, dynamic_rollout;
+  fixed_rollout.state_costs = Eigen::VectorXd::Random(NUM_TIMESTEPS);
+  fixed_rollout.control_costs.setZero(NUM_DIMENSIONS,NUM_TIMESTEPS);
+  fixed_rollout.total_costs.setZero(NUM_DIMENSIONS,NUM_TIMESTEPS);
+  fixed_rollout.full_costs.resize(NUM_DIMENSIONS);
+  dynamic_rollout = fixed_rollout;
+
+  StompKernels<NUM_DIMENSIONS>::computeControlCosts(x,DELTA_T,control_cost_weight,R,fixed_rollout.control_costs);
+  StompKernels<Eigen::Dynamic>::computeControlCosts(x,DELTA_T,control_cost_weight,R,dynamic_rollout.control_costs);
+  EXPECT_TRUE(fixed_rollout.control_costs.isApprox(dynamic_rollout.control_costs));
+  EXPECT_NEAR(fixed_rollout.control_costs.maxCoeff(),control_cost_weight,1e-12);
+
+  StompKernels<NUM_DIMENSIONS>::computeTotalCosts(fixed_rollout);
+  StompKernels<Eigen::Dynamic>::computeTotalCosts(dynamic_rollout);
+  EXPECT_TRUE(fixed_rollout.total_costs.isApprox(dynamic_rollout.total_costs));
+  EXPECT_NEAR(fixed_rollout.total_cost,dynamic_rollout.total_cost,1e-12);
+  EXPECT_NEAR(fixed_rollout.total_cost,
+              fixed_rollout.state_costs.sum() + fixed_rollout.control_costs.sum(),1e-12);
+  for(auto d = 0u; d < NUM_DIMENSIONS; d++)
+  {
+    EXPECT_NEAR(fixed_rollout.full_costs[d],dynamic_rollout.full_costs[d],1e-12);
+  }
+}
+
+#ifdef __GLIBC__
+/** @brief This tests that the iterations after the first one make no heap allocations */
+TEST(Stomp3DOF,allocation_free_iterations)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_rollouts = 10;
+  config.max_rollouts = 30;
+  config.num_iterations_after_valid = 10;
+  config.control_cost_weight = 0.1;
+  config.exponentiated_cost_sensitivity = 10.0;
+  config.noise_adaptation_rate = 0.1;
+  config.initialization_method = TrajectoryInitializations::MININUM_CONTROL_COST;
+
+  Trajectory optimized;
+  for(int num_threads : {1, 2})
+  {
+    config.num_threads = num_threads;
+    boost::shared_ptr<AllocationCountingTask> task(new AllocationCountingTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+    Stomp stomp(config,task);
+    stomp.solve(START_POS,END_POS,optimized);
+
+    EXPECT_GT(task->num_counted_iterations_,5)<<"threads: "<<num_threads;
+    EXPECT_EQ(task->max_iteration_allocations_,0)<<"threads: "<<num_threads;
+  }
+}
+#endif
+
+/** @brief This tests that the stencil based finite differences match the dense difference matrices */
+TEST(Stomp3DOF,stencil_finite_differences)
+{
+  using namespace stomp_core;
+
+  Eigen::VectorXd parameters = Eigen::VectorXd::Random(NUM_TIMESTEPS);
+  Eigen::VectorXd derivatives, expected_derivatives;
+  for(int order = DerivativeOrders::STOMP_POSITION; order <= DerivativeOrders::STOMP_JERK; order++)
+  {
+    differentiate(parameters,static_cast<DerivativeOrders::DerivativeOrder>(order),DELTA_T,derivatives);
+    differentiateDense(parameters,static_cast<DerivativeOrders::DerivativeOrder>(order),DELTA_T,expected_derivatives);
+    EXPECT_TRUE(derivatives.isApprox(expected_derivatives,1e-12))<<"order: "<<order;
+  }
+
+  Trajectory x = Trajectory::Random(NUM_DIMENSIONS,NUM_TIMESTEPS);
+  Eigen::VectorXd costs, expected_costs;
+  computeControlCosts(x,DELTA_T,costs);
+  computeControlCostsDense(x,DELTA_T,expected_costs);
+  EXPECT_TRUE(costs.isApprox(expected_costs,1e-12));
+
+  // fewer timesteps than the stencil length
+  Trajectory short_x = Trajectory::Random(NUM_DIMENSIONS,4);
+  computeControlCosts(short_x,DELTA_T,costs);
+  computeControlCostsDense(short_x,DELTA_T,expected_costs);
+  EXPECT_TRUE(costs.isApprox(expected_costs,1e-12));
+}
+
+/** @brief This tests that the discretization matrices are generated once and shared */
+TEST(Stomp3DOF,matrix_cache)
+{
+  using namespace stomp_core;
+
+  clearMatrixCache();
+  EXPECT_EQ(getMatrixCacheSize(),0);
+
+  // the control cost matrices of instances with the same discretization are shared
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  TaskPtr task(new DummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  StompConfiguration config = create3DOFConfiguration();
+  Stomp stomp1(config,task);
+  Stomp stomp2(config,task);
+  EXPECT_EQ(getMatrixCacheSize(),1);
+  ControlCostMatricesConstPtr matrices = getControlCostMatrices(config.num_timesteps,DELTA_T);
+  EXPECT_EQ(matrices,getControlCostMatrices(config.num_timesteps,DELTA_T));
+  EXPECT_EQ(matrices->control_cost_matrix_R_ldlt.info(),Eigen::Success);
+  EXPECT_NE(matrices,getControlCostMatrices(config.num_timesteps + 1,DELTA_T));
+
+  // cached matrices match the generated ones
+  Eigen::MatrixXd expected_smoothing;
+  generateSmoothingMatrix(NUM_TIMESTEPS,DELTA_T,expected_smoothing);
+  MatrixConstPtr smoothing = getSmoothingMatrix(NUM_TIMESTEPS,DELTA_T);
+  EXPECT_TRUE(smoothing->isApprox(expected_smoothing));
+  EXPECT_EQ(smoothing,getSmoothingMatrix(NUM_TIMESTEPS,DELTA_T));
+
+  // custom matrices are generated on the first request only
+  int num_generated = 0;
+  auto generate = [&num_generated](Eigen::MatrixXd& m)
+  {
+    num_generated++;
+    m = Eigen::MatrixXd::Identity(NUM_TIMESTEPS,NUM_TIMESTEPS);
+  };
+  MatrixConstPtr m1 = getCachedMatrix("test/identity",NUM_TIMESTEPS,DELTA_T,DerivativeOrders::STOMP_POSITION,generate);
+  MatrixConstPtr m2 = getCachedMatrix("test/identity",NUM_TIMESTEPS,DELTA_T,DerivativeOrders::STOMP_POSITION,generate);
+  EXPECT_EQ(num_generated,1);
+  EXPECT_EQ(m1,m2);
+  getCachedMatrix("test/identity",NUM_TIMESTEPS,DELTA_T,DerivativeOrders::STOMP_VELOCITY,generate);
+  EXPECT_EQ(num_generated,2);
+
+  // clearing keeps the matrices held by the callers valid
+  clearMatrixCache();
+  EXPECT_EQ(getMatrixCacheSize(),0);
+  EXPECT_TRUE(m1->isIdentity());
+  EXPECT_NE(m1,getCachedMatrix("test/identity",NUM_TIMESTEPS,DELTA_T,DerivativeOrders::STOMP_POSITION,generate));
+  EXPECT_EQ(num_generated,3);
+
+  // beyond its capacity the least recently requested entries are evicted
+  setMatrixCacheCapacity(2);
+  getCachedMatrix("test/identity",NUM_TIMESTEPS,DELTA_T,DerivativeOrders::STOMP_VELOCITY,generate);
+  getCachedMatrix("test/identity",NUM_TIMESTEPS,DELTA_T,DerivativeOrders::STOMP_POSITION,generate);
+  getCachedMatrix("test/identity",NUM_TIMESTEPS,DELTA_T,DerivativeOrders::STOMP_ACCELERATION,generate);
+  EXPECT_EQ(getMatrixCacheSize(),2);
+  EXPECT_EQ(num_generated,5);
+  getCachedMatrix("test/identity",NUM_TIMESTEPS,DELTA_T,DerivativeOrders::STOMP_POSITION,generate);
+  EXPECT_EQ(num_generated,5);
+  getCachedMatrix("test/identity",NUM_TIMESTEPS,DELTA_T,DerivativeOrders::STOMP_VELOCITY,generate);
+  EXPECT_EQ(num_generated,6);
+
+  setMatrixCacheCapacity(0);
+  EXPECT_EQ(getMatrixCacheSize(),0);
+  setMatrixCacheCapacity(32);
+}
+
+/** @brief This tests that the random streams are reproducible and independent of the order they are used in */
+TEST(Stomp3DOF,random_streams)
+{
+  using namespace stomp_core;
+
+  // the same key yields the same values
+  RandomStream stream1(7,2,3,1), stream2(7,2,3,1);
+  for(int i = 0; i < 100; i++)
+  {
+    ASSERT_EQ(stream1.nextInteger(),stream2.nextInteger());
+  }
+  EXPECT_EQ(stream1.getCounter(),100);
+  stream1.reset(7,2,3,1);
+  stream2.reset(7,2,3,1);
+  EXPECT_EQ(stream1.nextNormal(),stream2.nextNormal());
+
+  // any change of the key yields a different stream
+  std::set<std::uint64_t> first_values;
+  for(int seed = 0; seed < 2; seed++)
+  {
+    for(int iteration = 0; iteration < 4; iteration++)
+    {
+      for(int rollout = -1; rollout < 4; rollout++)
+      {
+        for(int dimension = 0; dimension < 4; dimension++)
+        {
+          first_values.insert(RandomStream(seed,iteration,rollout,dimension).nextInteger());
+        }
+      }
+    }
+  }
+  EXPECT_EQ(first_values.size(),2*4*5*4);
+
+  // distribution moments
+  RandomStream stream(3);
+  int num_samples = 100000;
+  double uniform_sum = 0, normal_sum = 0, normal_squared_sum = 0;
+  for(int i = 0; i < num_samples; i++)
+  {
+    double u = stream.nextUniform(-1,1);
+    ASSERT_TRUE(u >= -1 && u < 1);
+    uniform_sum += u;
+    double n = stream.nextNormal();
+    normal_sum += n;
+    normal_squared_sum += n*n;
+  }
+  EXPECT_NEAR(uniform_sum/num_samples,0,0.01);
+  EXPECT_NEAR(normal_sum/num_samples,0,0.01);
+  EXPECT_NEAR(normal_squared_sum/num_samples,1,0.02);
+
+  // serial and parallel runs draw the same noise so they reach the same solution
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  StompConfiguration config = create3DOFConfiguration();
+  std::vector<Trajectory> solutions;
+  for(int num_threads : {1,2,1})
+  {
+    config.num_threads = num_threads;
+    Stomp stomp(config,TaskPtr(new StreamDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV,11)));
+    solutions.push_back(Trajectory());
+    EXPECT_TRUE(stomp.solve(START_POS,END_POS,solutions.back()));
+  }
+  EXPECT_TRUE(solutions[0] == solutions[1]);
+  EXPECT_TRUE(solutions[0] == solutions[2]);
+}
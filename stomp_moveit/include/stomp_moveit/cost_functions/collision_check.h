@@ -26,9 +26,16 @@
 #ifndef INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_COST_FUNCTIONS_COLLISION_CHECK_H_
 #define INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_COST_FUNCTIONS_COLLISION_CHECK_H_
 
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <Eigen/Sparse>
 #include <moveit/robot_model/robot_model.h>
 #include "stomp_moveit/cost_functions/stomp_cost_function.h"
+#include "stomp_moveit/utils/collision_cache.h"
+#include "stomp_moveit/utils/segment_collision_check.h"
 
 namespace stomp_moveit
 {
@@ -113,15 +120,70 @@ public:
 
 protected:
 
+  /** @brief The robot states and collision data owned by a thread that checks a range of timesteps */
+  struct CollisionCheckWorkspace
+  {
+    moveit::core::RobotStatePtr robot_state;                                /**< @brief Used in checking collisions at a trajectory point */
+    std::array<moveit::core::RobotStatePtr,3 > intermediate_coll_states;   /**< @brief Used in checking collisions between to consecutive poses*/
+    collision_detection::CollisionRequest request;                          /**< @brief The collision request */
+    collision_detection::CollisionResult result;                            /**< @brief The collision result, cleared before every check */
+    Eigen::VectorXd intermediate_pose;                                      /**< @brief The joint values of the intermediate state being checked */
+  };
+
+  /**
+   * @brief Checks the timesteps in [first, last) of the trajectory and the segments that start at them, the state check
+   *        following a segment in collision is skipped.
+   * @param parameters      The parameters [num_dimensions x num_timesteps]
+   * @param rollout_number  The index of the rollout whose parameters are checked
+   * @param first           The first timestep to check
+   * @param last            One past the last timestep to check
+   * @param end             One past the last timestep of the trajectory window, no segment starts at 'end - 1'
+   * @param workspace       The robot states and collision data of the calling thread
+   */
+  void checkTimesteps(const Eigen::MatrixXd& parameters,int rollout_number,std::size_t first,std::size_t last,
+                      std::size_t end,CollisionCheckWorkspace& workspace);
+
+  /**
+   * @brief Starts a worker thread for each workspace but the first one, the threads wait for the trajectories handed
+   *        to them by computeCosts.
+   */
+  void startWorkers();
+
+  /**
+   * @brief Stops and joins the worker threads.
+   */
+  void stopWorkers();
+
+  /**
+   * @brief The loop run by a worker thread, it checks its range of timesteps every time it is signaled.
+   * @param w           The index of the worker workspace
+   * @param generation  The value of 'workers_generation_' when the worker was started
+   */
+  void runWorker(int w,int generation);
+
+  /**
+   * @brief Checks the robot against the world and itself at a single pose.
+   * @param joint_pose      The joint pose
+   * @param rollout_number  The index of the rollout the pose belongs to
+   * @param timestep        The timestep of the pose
+   * @param workspace       The robot states and collision data of the calling thread
+   * @return  True if the pose is in collision, false otherwise.
+   */
+  bool checkStateCollision(const Eigen::VectorXd& joint_pose,int rollout_number,std::size_t timestep,
+                           CollisionCheckWorkspace& workspace);
+
   /**
    * @brief Checks for collision between consecutive points by dividing the joint move into sub-moves where the maximum joint motion
-   *        can not exceed the @e longest_valid_joint_move value.
+   *        can not exceed the @e longest_valid_joint_move value.  When @e continuous_check is enabled the sub-moves that
+   *        are certified collision free by the clearance of their ends are skipped.
    * @param start                     The start joint pose
    * @param end                       The end joint pose
    * @param longest_valid_joint_move  The maximum distance that the joints are allowed to move before checking for collisions.
+   * @param workspace                 The robot states and collision data of the calling thread
    * @return  True if the interval is collision free, false otherwise.
    */
-  bool checkIntermediateCollisions(const Eigen::VectorXd& start, const Eigen::VectorXd& end,double longest_valid_joint_move);
+  bool checkIntermediateCollisions(const Eigen::VectorXd& start, const Eigen::VectorXd& end,double longest_valid_joint_move,
+                                   CollisionCheckWorkspace& workspace);
 
   std::string name_;
 
@@ -138,18 +200,43 @@ protected:
   double collision_penalty_;            /**< @brief The value assigned to a collision state */
   double kernel_window_percentage_;     /**< @brief The value assigned to a collision state */
   double longest_valid_joint_move_;     /**< @brief how far can a joint move in between consecutive trajectory points */
+  int num_threads_;                     /**< @brief Number of threads that check the timesteps of a trajectory, values less than 2 check serially */
+  bool continuous_check_;               /**< @brief Whether the segments between consecutive points are checked by conservative advancement */
 
   // cost calculation
   Eigen::VectorXd raw_costs_;
   Eigen::ArrayXd intermediate_costs_slots_;
+  std::vector<char> state_collisions_;    /**< @brief Whether the pose at each timestep of the window is in collision */
+  std::vector<char> segment_collisions_;  /**< @brief Whether the motion from each timestep of the window to the next is in collision */
 
   // collision
   collision_detection::CollisionRequest collision_request_;
   collision_detection::CollisionRobotConstPtr collision_robot_;
   collision_detection::CollisionWorldConstPtr collision_world_;
 
-  // intermediate collision check support
-  std::array<moveit::core::RobotStatePtr,3 > intermediate_coll_states_;   /**< @brief Used in checking collisions between to consecutive poses*/
+  // per thread collision check support, the first workspace shares 'robot_state_'
+  std::vector<CollisionCheckWorkspace> workspaces_;
+
+  // worker threads, kept for the whole plan so that they are not created on every call to computeCosts
+  std::vector<std::thread> worker_threads_;         /**< @brief The threads that check the ranges of timesteps after the first one */
+  std::mutex workers_mutex_;                        /**< @brief Guards the worker signaling members */
+  std::condition_variable workers_start_cv_;        /**< @brief Signals the workers that a new trajectory is ready */
+  std::condition_variable workers_done_cv_;         /**< @brief Signals the calling thread that a worker finished */
+  int workers_generation_;                          /**< @brief Incremented for every trajectory handed to the workers */
+  int workers_pending_;                             /**< @brief The number of workers still checking the current trajectory */
+  bool workers_exit_;                               /**< @brief Tells the workers to return */
+  const Eigen::MatrixXd* job_parameters_;           /**< @brief The parameters of the trajectory being checked */
+  int job_rollout_number_;                          /**< @brief The rollout of the trajectory being checked */
+  std::size_t job_start_;                           /**< @brief The first timestep of the window being checked */
+  std::size_t job_end_;                             /**< @brief One past the last timestep of the window being checked */
+  std::size_t job_range_size_;                      /**< @brief The number of timesteps checked by each thread */
+
+  // results of previously checked poses, shared by all the rollouts and iterations of a plan
+  utils::CollisionCache state_cache_;         /**< @brief Whether a trajectory pose is in collision */
+  utils::CollisionCache intermediate_cache_;  /**< @brief Whether an intermediate pose between consecutive points is in collision, or its clearance for the continuous check */
+
+  // continuous checking of the segments between consecutive points
+  utils::SegmentCollisionCheck segment_check_;
 
 };
 
@@ -0,0 +1,180 @@
+/**
+ * @file obstacle_distance_field.h
+ * @brief This defines a cost function that evaluates the distance to the world through a signed distance field.
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_COST_FUNCTIONS_OBSTACLE_DISTANCE_FIELD_H_
+#define INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_COST_FUNCTIONS_OBSTACLE_DISTANCE_FIELD_H_
+
+#include <memory>
+#include <vector>
+#include <stomp_moveit/cost_functions/stomp_cost_function.h>
+#include <moveit/distance_field/propagation_distance_field.h>
+
+namespace stomp_moveit
+{
+namespace cost_functions
+{
+/**
+ * @class stomp_moveit::cost_functions::ObstacleDistanceField
+ * @brief Assigns a cost value to each robot state by evaluating the minimum distance between the robot and the world.  The
+ * world geometry is voxelized into a signed distance field when the plan request is set and the robot links are
+ * approximated by spheres, so that the distance of a state only takes a field lookup per sphere.  Self collisions are
+ * not evaluated.
+ *
+ * @par Examples:
+ * All examples are located here @ref stomp_moveit_examples
+ */
+class ObstacleDistanceField : public StompCostFunction
+{
+public:
+  ObstacleDistanceField();
+  virtual ~ObstacleDistanceField();
+
+  /**
+   * @brief Initializes and configures the Cost Function.  Calls the configure method and passes the 'config' value.
+   * @param robot_model_ptr A pointer to the robot model.
+   * @param group_name      The designated planning group.
+   * @param config          The configuration data.  Usually loaded from the ros parameter server
+   * @return true if succeeded, false otherwise.
+   */
+  virtual bool initialize(moveit::core::RobotModelConstPtr robot_model_ptr, const std::string& group_name,
+                          XmlRpc::XmlRpcValue& config) override;
+
+  /**
+   * @brief Sets internal members of the plugin from the configuration data.
+   * @param config  The configuration data .  Usually loaded from the ros parameter server
+   * @return  true if succeeded, false otherwise.
+   */
+  virtual bool configure(const XmlRpc::XmlRpcValue& config) override;
+
+  /**
+   * @brief Builds the distance field of the world and the collision spheres of the robot.
+   * @param planning_scene      A smart pointer to the planning scene
+   * @param req                 The motion planning request
+   * @param config              The  Stomp configuration.
+   * @param error_code          Moveit error code.
+   * @return  true if succeeded, false otherwise.
+   */
+  virtual bool setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                    const moveit_msgs::MotionPlanRequest &req,
+                                    const stomp_core::StompConfiguration &config,
+                                    moveit_msgs::MoveItErrorCodes& error_code) override;
+
+  /**
+   * @brief computes the state costs from the minimum distance between the robot spheres and the world.
+   * @param parameters        The parameter values to evaluate for state costs [num_dimensions x num_parameters]
+   * @param start_timestep    start index into the 'parameters' array, usually 0.
+   * @param num_timesteps     number of elements to use from 'parameters' starting from 'start_timestep'   *
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param rollout_number    index of the noisy trajectory whose cost is being evaluated.   *
+   * @param costs             vector containing the state costs per timestep.
+   * @param validity          whether or not the trajectory is valid
+   * @return false if there was an irrecoverable failure, true otherwise.
+   */
+  virtual bool computeCosts(const Eigen::MatrixXd& parameters, std::size_t start_timestep, std::size_t num_timesteps,
+                            int iteration_number, int rollout_number, Eigen::VectorXd& costs, bool& validity) override;
+
+  virtual std::string getGroupName() const override
+  {
+    return group_name_;
+  }
+
+  virtual std::string getName() const override
+  {
+    return name_ + "/" + group_name_  ;
+  }
+
+  virtual void done(bool success,int total_iterations,double final_cost,const Eigen::MatrixXd& parameters) override;
+
+
+protected:
+
+  /**
+   * @brief A sphere that encloses part of the geometry of a link
+   */
+  struct CollisionSphere
+  {
+    const moveit::core::LinkModel* link;    /**< @brief The link the sphere moves with */
+    Eigen::Vector3d center;                 /**< @brief The center in the link frame */
+    double radius;                          /**< @brief The radius */
+  };
+
+  /**
+   * @brief Covers the link geometry and the attached bodies of the links that move with the group with spheres.
+   * @param state The state holding the attached bodies
+   */
+  void createCollisionSpheres(const moveit::core::RobotState& state);
+
+  /**
+   * @brief Voxelizes the world geometry of the planning scene into the distance field.
+   * @param state The start state, the default bounds of the field are centered at its root link
+   * @return  true if succeeded, false otherwise.
+   */
+  bool createDistanceField(const moveit::core::RobotState& state);
+
+  /**
+   * @brief Interpolates the signed distance at a point from the eight surrounding cells of the field.
+   * @param point The point in the planning frame
+   * @return  The signed distance, the propagation limit of the field outside of it.
+   */
+  double getDistance(const Eigen::Vector3d& point) const;
+
+  /**
+   * @brief Computes the clearance between the robot spheres and the world at a robot state.
+   * @param state The state with updated link transforms
+   * @return  The smallest distance from a sphere surface to the world, negative when in collision and at most
+   *          @e max_distance.
+   */
+  double computeClearance(const moveit::core::RobotState& state) const;
+
+  std::string name_;
+
+  // robot details
+  std::string group_name_;
+  moveit::core::RobotModelConstPtr robot_model_ptr_;
+  moveit::core::RobotStatePtr robot_state_;
+
+  // planning context information
+  planning_scene::PlanningSceneConstPtr planning_scene_;
+  moveit_msgs::MotionPlanRequest plan_request_;
+
+  // distance computation
+  std::shared_ptr<distance_field::PropagationDistanceField> distance_field_;  /**< @brief The signed distance to the world geometry */
+  std::vector<CollisionSphere> collision_spheres_;                          /**< @brief Spheres enclosing the robot geometry that moves with the group */
+  double max_sphere_radius_;                                                /**< @brief The radius of the largest collision sphere */
+  Eigen::VectorXd intermediate_pose_;                                       /**< @brief The joint values of the intermediate pose being checked */
+
+  // parameters
+  double max_distance_;               /**< @brief maximum distance from at which the trajectory will be penalized */
+  double longest_valid_joint_move_;   /**< @brief how far can a joint move in between consecutive trajectory points */
+  double resolution_;                 /**< @brief The size of the cells of the distance field */
+  std::vector<double> workspace_bounds_;  /**< @brief The [min_x, min_y, min_z, max_x, max_y, max_z] corners of the field, empty to enclose the robot reach */
+
+};
+
+} /* namespace cost_functions */
+} /* namespace stomp_moveit */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_COST_FUNCTIONS_OBSTACLE_DISTANCE_FIELD_H_ */
@@ -28,6 +28,8 @@
 #define INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_COST_FUNCTIONS_OBSTACLE_DISTANCE_GRADIENT_H_
 
 #include <stomp_moveit/cost_functions/stomp_cost_function.h>
+#include <stomp_moveit/utils/collision_cache.h>
+#include <stomp_moveit/utils/segment_collision_check.h>
 #include <array>
 
 namespace stomp_moveit
@@ -109,7 +111,8 @@ protected:
 
   /**
    * @brief Checks for collision between consecutive points by dividing the joint move into sub-moves where the maximum joint motion
-   *        can not exceed the @e longest_valid_joint_move value.
+   *        can not exceed the @e longest_valid_joint_move value.  When @e continuous_check is enabled the sub-moves that
+   *        are certified collision free by the clearance of their ends are skipped.
    * @param start                     The start joint pose
    * @param end                       The end joint pose
    * @param longest_valid_joint_move  The maximum distance that the joints are allowed to move before checking for collisions.
@@ -127,6 +130,8 @@ protected:
 
   // intermediate collision check support
   std::array<moveit::core::RobotStatePtr,3 > intermediate_coll_states_;   /**< @brief Used in checking collisions between to consecutive poses*/
+  Eigen::VectorXd intermediate_pose_;                                      /**< @brief The joint values of the intermediate state being checked */
+  utils::SegmentCollisionCheck segment_check_;                             /**< @brief Checks the segments by conservative advancement */
 
 
   // planning context information
@@ -137,9 +142,14 @@ protected:
   collision_detection::CollisionRequest collision_request_;
   collision_detection::CollisionResult collision_result_;
 
+  // results of previously checked poses, shared by all the rollouts and iterations of a plan
+  utils::CollisionCache distance_cache_;      /**< @brief The obstacle distance of a trajectory pose, negative when in collision */
+  utils::CollisionCache intermediate_cache_;  /**< @brief Whether an intermediate pose between consecutive points is in collision, or its clearance for the continuous check */
+
   // parameters
   double max_distance_;               /**< @brief maximum distance from at which the trajectory will be penalized */
   double longest_valid_joint_move_;   /**< @brief how far can a joint move in between consecutive trajectory points */
+  bool continuous_check_;             /**< @brief Whether the segments between consecutive points are checked by conservative advancement */
 
 };
 
@@ -33,6 +33,7 @@
 #include <moveit/robot_model/robot_model.h>
 #include <moveit/robot_trajectory/robot_trajectory.h>
 #include <moveit/planning_scene/planning_scene.h>
+#include <stomp_moveit/utils/forward_kinematics_cache.h>
 
 namespace stomp_moveit
 {
@@ -132,6 +133,16 @@ public:
    */
   virtual void done(bool success,int total_iterations,double final_cost,const Eigen::MatrixXd& parameters){}
 
+  /**
+   * @brief Sets the robot states of the rollout timesteps shared by the plugins of the task.  The plugins that evaluate
+   *        the robot kinematics at the timesteps read them from it instead of updating their own state.
+   * @param kinematics_cache  The shared cache
+   */
+  virtual void setKinematicsCache(utils::ForwardKinematicsCachePtr kinematics_cache)
+  {
+    kinematics_cache_ = kinematics_cache;
+  }
+
 
   virtual std::string getGroupName() const
   {
@@ -162,6 +173,7 @@ public:
 protected:
 
   double cost_weight_;
+  utils::ForwardKinematicsCachePtr kinematics_cache_;   /**< @brief The robot states shared by the plugins of the task, may be null */
 
 };
 
@@ -109,9 +109,10 @@ protected:
   std::string group_;
 
   // random noise generation
-  std::vector<utils::MultivariateGaussianPtr> rand_generators_;
+  utils::MultivariateGaussianPtr rand_generator_;
   Eigen::VectorXd raw_noise_;
   std::vector<double> stddev_;
+  std::uint64_t seed_;              /**< @brief Seed of the random streams, each (iteration, rollout, dimension) samples its own stream */
 
 };
 
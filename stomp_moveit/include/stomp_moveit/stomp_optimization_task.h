@@ -36,6 +36,7 @@
 #include <stomp_moveit/noise_generators/stomp_noise_generator.h>
 #include <stomp_moveit/noisy_filters/stomp_noisy_filter.h>
 #include <stomp_moveit/update_filters/stomp_update_filter.h>
+#include <stomp_moveit/utils/forward_kinematics_cache.h>
 
 
 namespace stomp_moveit
@@ -55,6 +56,11 @@ typedef std::shared_ptr<NoiseGeneratorLoader> NoiseGeneratorLoaderPtr;
  * @class stomp_moveit::StompOptimizationTask
  * @brief Loads and manages the STOMP plugins during the planning process.
  *
+ * The plugins of a task share the robot states of its forward kinematics cache, which has one unguarded slot per
+ * rollout timestep.  A task must therefore not evaluate the same rollout from two threads at once, and a plugin may
+ * only spread the timesteps of a rollout over several threads.  Parallel rollout evaluation uses a clone per thread,
+ * each clone has its own cache.
+ *
  * @par Examples:
  * All examples are located here @ref stomp_moveit_examples
  *
@@ -85,6 +91,30 @@ public:
                    const stomp_core::StompConfiguration &config,
                    moveit_msgs::MoveItErrorCodes& error_code);
 
+  /**
+   * @brief Passes the last motion plan request down to each loaded plugin with the number of timesteps changed, used
+   * by the coarse to fine optimization.
+   * @param num_timesteps       The number of timesteps of the parameters to be evaluated next
+   * @return  true if succeeded,false otherwise.
+   */
+  virtual bool setNumTimesteps(int num_timesteps) override;
+
+  /**
+   * @brief Creates a task with its own instances of the plugins, set up with the current motion plan request, so
+   * that the rollouts can be evaluated by several worker threads.  The plugins are not thread-safe so each worker
+   * must use its own copy.
+   * @return A new task or an empty pointer if the plugins failed to load or to accept the plan request
+   */
+  virtual stomp_core::TaskPtr clone() const override;
+
+  /**
+   * @brief Passes the current motion plan request to the plugins of a clone, this is skipped when the clone already
+   * has the same request and number of timesteps.
+   * @param clone A task returned by clone
+   * @return True if the clone is up to date, false if it is not a clone of this task or its plugins failed
+   */
+  virtual bool updateClone(stomp_core::Task& clone) const override;
+
   /**
    * @brief Generates a noisy trajectory from the parameters by calling the active Noise Generator plugin.
    * @param parameters        [num_dimensions] x [num_parameters] the current value of the optimized parameters
@@ -197,13 +227,35 @@ public:
    */
   virtual void done(bool success,int total_iterations,double final_cost,const Eigen::MatrixXd& parameters) override;
 
+protected:
+
+  /**
+   * @brief Passes the planning details down to each loaded plugin
+   * @param planning_scene  A smart pointer to the planning scene
+   * @param req                 The motion planning request
+   * @param config              The  Stomp configuration
+   * @param error_code          Moveit error code
+   * @return  true if succeeded,false otherwise.
+   */
+  bool setPluginsMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                   const moveit_msgs::MotionPlanRequest &req,
+                                   const stomp_core::StompConfiguration &config,
+                                   moveit_msgs::MoveItErrorCodes& error_code);
+
 protected:
 
   // robot environment
   std::string group_name_;
   moveit::core::RobotModelConstPtr robot_model_ptr_;
+  XmlRpc::XmlRpcValue config_;           /**< @brief The task configuration the plugins were loaded from */
   planning_scene::PlanningSceneConstPtr planning_scene_ptr_;
 
+  // last motion plan request, used when the number of timesteps changes
+  moveit_msgs::MotionPlanRequest plan_request_;
+  stomp_core::StompConfiguration stomp_config_;
+  stomp_core::StompConfiguration active_config_;   /**< @brief The configuration last passed to the plugins, differs from 'stomp_config_' during the coarse optimization */
+  unsigned int request_count_;                     /**< @brief The number of motion plan requests received, a clone holds the count of the request passed to it */
+
   /**< The plugin loaders for each type of plugin supported>*/
   CostFuctionLoaderPtr cost_function_loader_;
   NoisyFilterLoaderPtr noisy_filter_loader_;
@@ -215,6 +267,9 @@ protected:
   std::vector<noisy_filters::StompNoisyFilterPtr> noisy_filters_;
   std::vector<update_filters::StompUpdateFilterPtr> update_filters_;
   std::vector<noise_generators::StompNoiseGeneratorPtr> noise_generators_;
+
+  /**< The robot states of the rollout timesteps shared by the plugins, a slot must not be used by two threads at once >*/
+  utils::ForwardKinematicsCachePtr kinematics_cache_;
 };
 
 
@@ -0,0 +1,157 @@
+/**
+ * @file collision_cache.h
+ * @brief This contains a cache of the collision check results of joint configurations
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDE_STOMP_MOVEIT_UTILS_COLLISION_CACHE_H_
+#define INCLUDE_STOMP_MOVEIT_UTILS_COLLISION_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <Eigen/Core>
+
+/**
+ * @namespace stomp_moveit
+ */
+namespace stomp_moveit
+{
+
+/**
+ * @namespace utils
+ */
+namespace utils
+{
+
+/** @brief The usage counters of a CollisionCache */
+struct CollisionCacheStatistics
+{
+  std::size_t hits = 0;           /**< @brief Number of lookups that found a result */
+  std::size_t misses = 0;         /**< @brief Number of lookups that found no result */
+  std::size_t evictions = 0;      /**< @brief Number of least recently used results dropped to make room */
+  std::size_t invalidations = 0;  /**< @brief Number of times all the results were dropped because of a new planning scene */
+};
+
+/**
+ * @brief A bounded least recently used cache of the results of a collision or distance check.  The results are keyed
+ * by the joint configuration quantized to a resolution, so configurations closer than the resolution share a result,
+ * and by the version of the planning scene they were computed in.  Thread-safe.
+ */
+class CollisionCache
+{
+public:
+
+  /**
+   * @brief Creates a disabled cache
+   */
+  CollisionCache();
+
+  /**
+   * @brief Sets the size and the resolution of the cache, this drops all the results.
+   * @param capacity    The maximum number of results, 0 disables the cache
+   * @param resolution  The joint distance under which configurations share a result, in radians or meters
+   * @return True if the parameters are valid, otherwise false
+   */
+  bool configure(std::size_t capacity,double resolution);
+
+  /**
+   * @brief Whether the cache stores results
+   * @return True if the capacity is greater than 0, otherwise false
+   */
+  bool isEnabled() const
+  {
+    return capacity_ > 0;
+  }
+
+  /**
+   * @brief Gets the quantization step of the joint values, two configurations that share a result differ by at most
+   * this much in each joint
+   * @return The resolution in radians or meters
+   */
+  double getResolution() const
+  {
+    return resolution_;
+  }
+
+  /**
+   * @brief Moves the cache to a new planning scene, the results of the previous scene are dropped.
+   */
+  void invalidate();
+
+  /**
+   * @brief Gets the result of a joint configuration
+   * @param joint_pose  The joint configuration
+   * @param result      Receives the result when found
+   * @return True if the result was found, otherwise false
+   */
+  bool lookup(const Eigen::VectorXd& joint_pose,double& result);
+
+  /**
+   * @brief Stores the result of a joint configuration, the least recently used result is dropped when the cache is full
+   * @param joint_pose  The joint configuration
+   * @param result      The result
+   */
+  void insert(const Eigen::VectorXd& joint_pose,double result);
+
+  /**
+   * @brief Gets the usage counters
+   * @return The counters accumulated since the cache was configured
+   */
+  CollisionCacheStatistics getStatistics() const;
+
+protected:
+
+  typedef std::vector<std::int64_t> Key;  /**< @brief The scene version followed by the quantized joint values */
+
+  /** @brief Hashes a key */
+  struct KeyHash
+  {
+    std::size_t operator()(const Key& key) const;
+  };
+
+  typedef std::list<std::pair<Key,double> > EntryList;  /**< @brief The results from the most to the least recently used */
+
+  /**
+   * @brief Computes the key of a joint configuration in the current scene
+   * @param joint_pose  The joint configuration
+   * @param key         Receives the key
+   */
+  void computeKey(const Eigen::VectorXd& joint_pose,Key& key) const;
+
+  std::size_t capacity_;                                            /**< @brief The maximum number of results */
+  double resolution_;                                               /**< @brief The quantization step of the joint values */
+  std::int64_t scene_version_;                                      /**< @brief Incremented for every new planning scene */
+  EntryList entries_;                                               /**< @brief The cached results */
+  std::unordered_map<Key,EntryList::iterator,KeyHash> index_;       /**< @brief Locates the entry of a key */
+  CollisionCacheStatistics statistics_;                             /**< @brief The usage counters */
+  mutable std::mutex mutex_;                                        /**< @brief Guards all the members above except the parameters */
+};
+
+} /* namespace utils */
+} /* namespace stomp_moveit */
+
+#endif /* INCLUDE_STOMP_MOVEIT_UTILS_COLLISION_CACHE_H_ */
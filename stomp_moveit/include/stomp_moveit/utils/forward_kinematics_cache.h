@@ -0,0 +1,141 @@
+/**
+ * @file forward_kinematics_cache.h
+ * @brief This contains the robot states of the rollout timesteps shared by the plugins of a task
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDE_STOMP_MOVEIT_UTILS_FORWARD_KINEMATICS_CACHE_H_
+#define INCLUDE_STOMP_MOVEIT_UTILS_FORWARD_KINEMATICS_CACHE_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <Eigen/Core>
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+
+/**
+ * @namespace stomp_moveit
+ */
+namespace stomp_moveit
+{
+
+/**
+ * @namespace utils
+ */
+namespace utils
+{
+
+class ForwardKinematicsCache;
+typedef std::shared_ptr<ForwardKinematicsCache> ForwardKinematicsCachePtr;
+
+/**
+ * @brief Holds an updated robot state for every (rollout, timestep) of the current plan so that the plugins evaluating
+ * the same rollout parameters share a single forward kinematics computation.  A state is recomputed whenever the joint
+ * values requested for its slot differ from the ones it was computed with, so changes made to the parameters by the
+ * filters are always reflected.  Different rollouts, and different timesteps of a rollout, may be requested from
+ * different threads but a slot must not be requested concurrently.
+ */
+class ForwardKinematicsCache
+{
+public:
+
+  /**
+   * @brief The rollout number of the noiseless (optimized) parameters
+   */
+  static const int OPTIMIZED_ROLLOUT = -1;
+
+  /**
+   * @brief Constructor
+   * @param robot_model The robot model
+   * @param group_name  The planning group whose joint values are set
+   */
+  ForwardKinematicsCache(moveit::core::RobotModelConstPtr robot_model,const std::string& group_name);
+
+  /**
+   * @brief Drops all the states and allocates the slots of a plan, one per timestep of the optimized rollout and of
+   * the rollouts in [0, num_rollouts).  Only those rollouts are served, the requests for the rollouts reused beyond
+   * them return null.
+   * @param start_state   The state holding the values of the joints outside of the group and the attached bodies
+   * @param num_rollouts  The number of new noisy rollouts of each iteration
+   * @param num_timesteps The number of timesteps
+   */
+  void reset(const moveit::core::RobotState& start_state,int num_rollouts,int num_timesteps);
+
+  /**
+   * @brief Gets the state of a rollout timestep with the group at the joint pose, computing it when needed.
+   * @param rollout_number  The rollout index, or OPTIMIZED_ROLLOUT for the optimized parameters
+   * @param timestep        The timestep index
+   * @param joint_pose      The joint values of the group
+   * @return The updated state, null when the slot is out of range.  The state remains valid until the slot is
+   * requested again or the cache is reset, so a slot must not be requested concurrently.
+   */
+  const moveit::core::RobotState* getState(int rollout_number,std::size_t timestep,const Eigen::VectorXd& joint_pose);
+
+  /**
+   * @brief Gets the number of states that were reused and computed since the last reset.
+   * @param hits    Receives the number of requests served by a previously computed state
+   * @param misses  Receives the number of requests that computed the state
+   */
+  void getStatistics(std::size_t& hits,std::size_t& misses) const;
+
+protected:
+
+  /**
+   * @brief A state and the joint values of the group it was computed with
+   */
+  struct Slot
+  {
+    moveit::core::RobotStatePtr state;  /**< @brief The updated state, created on the first request */
+    Eigen::VectorXd joint_pose;         /**< @brief The joint values of the group in the state */
+  };
+
+  moveit::core::RobotModelConstPtr robot_model_;
+  const moveit::core::JointModelGroup* joint_group_;
+  moveit::core::RobotStatePtr start_state_;
+  std::vector<Slot> slots_;           /**< @brief The slots [num_rollouts + 1][num_timesteps], the optimized rollout first */
+  std::size_t num_timesteps_;
+  std::atomic<std::size_t> hits_;
+  std::atomic<std::size_t> misses_;
+};
+
+/**
+ * @brief Gets the state of a rollout timestep from the cache, or computes it into the given state when the cache is
+ * not set or does not hold the slot.
+ * @param cache           The shared cache, may be null
+ * @param rollout_number  The rollout index, or ForwardKinematicsCache::OPTIMIZED_ROLLOUT for the optimized parameters
+ * @param timestep        The timestep index
+ * @param joint_pose      The joint values of the group
+ * @param joint_group     The planning group
+ * @param state           The state used when the cache can not serve the request
+ * @return The updated state
+ */
+const moveit::core::RobotState& getRolloutState(const ForwardKinematicsCachePtr& cache,int rollout_number,
+                                                std::size_t timestep,const Eigen::VectorXd& joint_pose,
+                                                const moveit::core::JointModelGroup* joint_group,
+                                                moveit::core::RobotState& state);
+
+} /* namespace utils */
+} /* namespace stomp_moveit */
+
+#endif /* INCLUDE_STOMP_MOVEIT_UTILS_FORWARD_KINEMATICS_CACHE_H_ */
@@ -39,11 +39,9 @@
 
 #include <Eigen/Core>
 #include <Eigen/Cholesky>
-#include <boost/random/variate_generator.hpp>
-#include <boost/random/normal_distribution.hpp>
-#include <boost/random/mersenne_twister.hpp>
 #include <boost/shared_ptr.hpp>
-#include <cstdlib>
+#include <cstdint>
+#include <stomp_core/random_stream.h>
 
 namespace stomp_moveit
 {
@@ -60,8 +58,26 @@ typedef boost::shared_ptr<MultivariateGaussian> MultivariateGaussianPtr;
 class MultivariateGaussian
 {
 public:
+  /**
+   * @brief Creates the distribution
+   * @param mean        The mean of the distribution
+   * @param covariance  The covariance of the distribution
+   * @param seed        The seed of the internal random stream
+   */
   template <typename Derived1, typename Derived2>
-  MultivariateGaussian(const Eigen::MatrixBase<Derived1>& mean, const Eigen::MatrixBase<Derived2>& covariance);
+  MultivariateGaussian(const Eigen::MatrixBase<Derived1>& mean, const Eigen::MatrixBase<Derived2>& covariance,
+                       std::uint64_t seed = 0);
+
+  /**
+   * @brief Creates the distribution from a precomputed Cholesky decomposition, e.g. shared by several distributions
+   * @param mean                The mean of the distribution
+   * @param covariance          The covariance of the distribution
+   * @param covariance_cholesky The lower triangular L of the covariance decomposition LL^T
+   * @param seed                The seed of the internal random stream
+   */
+  template <typename Derived1, typename Derived2, typename Derived3>
+  MultivariateGaussian(const Eigen::MatrixBase<Derived1>& mean, const Eigen::MatrixBase<Derived2>& covariance,
+                       const Eigen::MatrixBase<Derived3>& covariance_cholesky, std::uint64_t seed = 0);
 
   /**
    * @brief generates random values using a normal distribution.
@@ -71,37 +87,60 @@ public:
   template <typename Derived>
   void sample(Eigen::MatrixBase<Derived>& output,bool use_covariance = true);
 
+  /**
+   * @brief generates random values from the given stream, this does not modify the distribution so it can be called
+   * concurrently with distinct streams.
+   * @param output          The random values
+   * @param stream          The random stream, e.g. the one of the current (iteration, rollout, dimension)
+   * @param use_covariance  True to apply the covariance matrix onto the random values, false otherwise
+   */
+  template <typename Derived>
+  void sample(Eigen::MatrixBase<Derived>& output,stomp_core::RandomStream& stream,bool use_covariance = true) const;
+
 private:
   Eigen::VectorXd mean_;                /**< Mean of the gaussian distribution */
   Eigen::MatrixXd covariance_;          /**< Covariance of the gaussian distribution */
   Eigen::MatrixXd covariance_cholesky_; /**< Cholesky decomposition (LL^T) of the covariance */
 
   int size_;
-  boost::mt19937 rng_;
-  boost::normal_distribution<> normal_dist_;
-  boost::shared_ptr<boost::variate_generator<boost::mt19937, boost::normal_distribution<> > > gaussian_;
+  stomp_core::RandomStream stream_;     /**< Random stream used when none is given to sample */
 };
 
 //////////////////////// template function definitions follow //////////////////////////////
 
 template <typename Derived1, typename Derived2>
-MultivariateGaussian::MultivariateGaussian(const Eigen::MatrixBase<Derived1>& mean, const Eigen::MatrixBase<Derived2>& covariance):
+MultivariateGaussian::MultivariateGaussian(const Eigen::MatrixBase<Derived1>& mean, const Eigen::MatrixBase<Derived2>& covariance,
+                                           std::uint64_t seed):
   mean_(mean),
   covariance_(covariance),
   covariance_cholesky_(covariance_.llt().matrixL()),
-  normal_dist_(0.0,1.0)
+  stream_(seed)
 {
+  size_ = mean.rows();
+}
 
-  rng_.seed(rand());
+template <typename Derived1, typename Derived2, typename Derived3>
+MultivariateGaussian::MultivariateGaussian(const Eigen::MatrixBase<Derived1>& mean, const Eigen::MatrixBase<Derived2>& covariance,
+                                           const Eigen::MatrixBase<Derived3>& covariance_cholesky, std::uint64_t seed):
+  mean_(mean),
+  covariance_(covariance),
+  covariance_cholesky_(covariance_cholesky),
+  stream_(seed)
+{
   size_ = mean.rows();
-  gaussian_.reset(new boost::variate_generator<boost::mt19937, boost::normal_distribution<> >(rng_, normal_dist_));
 }
 
 template <typename Derived>
 void MultivariateGaussian::sample(Eigen::MatrixBase<Derived>& output,bool use_covariance)
+{
+  sample(output,stream_,use_covariance);
+}
+
+template <typename Derived>
+void MultivariateGaussian::sample(Eigen::MatrixBase<Derived>& output,stomp_core::RandomStream& stream,bool use_covariance) const
 {
   for (int i=0; i<size_; ++i)
-    output(i) = (*gaussian_)();
+    output(i) = stream.nextNormal();
 
   if(use_covariance)
   {
@@ -0,0 +1,146 @@
+/**
+ * @file segment_collision_check.h
+ * @brief This contains a continuous collision check of the straight joint motion between two poses
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDE_STOMP_MOVEIT_UTILS_SEGMENT_COLLISION_CHECK_H_
+#define INCLUDE_STOMP_MOVEIT_UTILS_SEGMENT_COLLISION_CHECK_H_
+
+#include <vector>
+#include <Eigen/Core>
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <stomp_moveit/utils/collision_cache.h>
+
+/**
+ * @namespace stomp_moveit
+ */
+namespace stomp_moveit
+{
+
+/**
+ * @namespace utils
+ */
+namespace utils
+{
+
+/**
+ * @brief Computes the radius of a sphere centered at the link frame that encloses the link geometry and its attached bodies.
+ * @param link  The link
+ * @param state A state holding the attached bodies
+ * @return The radius
+ */
+double computeLinkRadius(const moveit::core::LinkModel* link,const moveit::core::RobotState& state);
+
+/**
+ * @brief Computes an upper bound on the distance from the frame of a link to its descendant link, for any joint values
+ * @param ancestor    The link whose frame is the reference
+ * @param descendant  The descendant link
+ * @return The sum of the joint origin offsets along the chain, prismatic joints add their largest travel
+ */
+double computeChainReach(const moveit::core::LinkModel* ancestor,const moveit::core::LinkModel* descendant);
+
+/**
+ * @brief Checks the straight joint motion between two poses by conservative advancement.  Every joint of the group
+ * has a bound on how far any point of the robot geometry below it moves per unit of joint motion, so the whole robot
+ * moves at most B = sum_j(bound_j*|end_j - start_j|) over the segment.  An interval whose end clearances add up to more
+ * than the motion bound of the interval is collision free, otherwise it is bisected.  Bisection stops once an interval
+ * is shorter than the discrete resolution, where the interval is accepted if its inner end is collision free as
+ * the interpolation at that resolution would.
+ */
+class SegmentCollisionCheck
+{
+public:
+  SegmentCollisionCheck();
+
+  /**
+   * @brief Computes the motion bounds of the joints in the group and restricts the clearance queries to the geometry
+   * that moves with the group.
+   * @param robot_model     The robot model
+   * @param planning_scene  The planning scene the segments are checked in
+   * @param group_name      The planning group whose joints move
+   * @param state           A state holding the attached bodies, which extend the geometry of their links
+   * @return True if every joint of the group is revolute or prismatic, otherwise false and the check is disabled
+   */
+  bool initialize(moveit::core::RobotModelConstPtr robot_model,const planning_scene::PlanningScene& planning_scene,
+                  const std::string& group_name,const moveit::core::RobotState& state);
+
+  /**
+   * @brief Whether the motion bounds were computed
+   * @return True after a successful initialization, otherwise false
+   */
+  bool isInitialized() const
+  {
+    return !joint_motion_bounds_.empty();
+  }
+
+  /**
+   * @brief Gets an upper bound on how far any point of the robot moves along the segment
+   * @param start   The start joint pose
+   * @param end     The end joint pose
+   * @return The motion bound in meters
+   */
+  double getMotionBound(const Eigen::VectorXd& start,const Eigen::VectorXd& end) const;
+
+  /**
+   * @brief Checks whether the segment between the two joint poses is collision free, the poses themselves are not checked.
+   * @param planning_scene            The planning scene
+   * @param start                     The start joint pose
+   * @param end                       The end joint pose
+   * @param longest_valid_joint_move  The discrete resolution, intervals where no joint moves more than this are not bisected
+   * @param state                     A state used to evaluate the poses along the segment
+   * @param cache                     Stores the clearance of the evaluated poses, may be null
+   * @return True if the segment is collision free, false otherwise.
+   */
+  bool isSegmentCollisionFree(const planning_scene::PlanningScene& planning_scene,const Eigen::VectorXd& start,
+                              const Eigen::VectorXd& end,double longest_valid_joint_move,
+                              moveit::core::RobotState& state,CollisionCache* cache = nullptr) const;
+
+protected:
+
+  /**
+   * @brief Computes the clearance of the geometry that moves with the group to the world and to the robot itself.
+   *        Both robot links may approach each other so half of the self distance is used.  The static geometry is
+   *        left out as its distance to the world does not change along a segment.
+   * @param planning_scene  The planning scene
+   * @param joint_pose      The joint pose
+   * @param state           A state used to evaluate the pose
+   * @param cache           Stores the clearance of the evaluated poses, may be null.  A cached clearance is reduced by
+   *                        the motion bound across a quantization cell so that it remains conservative.
+   * @return The clearance in meters, negative when in collision
+   */
+  double computeClearance(const planning_scene::PlanningScene& planning_scene,const Eigen::VectorXd& joint_pose,
+                          moveit::core::RobotState& state,CollisionCache* cache) const;
+
+  std::string group_name_;
+  collision_detection::AllowedCollisionMatrix world_acm_;  /**< @brief The scene matrix that also allows the static geometry to touch the world */
+  collision_detection::AllowedCollisionMatrix self_acm_;   /**< @brief The scene matrix that also allows the static geometry to touch itself */
+  std::vector<double> joint_motion_bounds_;   /**< @brief The distance moved by the robot geometry per unit of motion of each group variable */
+};
+
+} /* namespace utils */
+} /* namespace stomp_moveit */
+
+#endif /* INCLUDE_STOMP_MOVEIT_UTILS_SEGMENT_COLLISION_CHECK_H_ */
@@ -23,6 +23,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
 #include <ros/console.h>
 #include <pluginlib/class_list_macros.h>
 #include <moveit/robot_state/conversions.h>
@@ -31,6 +32,7 @@
 PLUGINLIB_EXPORT_CLASS(stomp_moveit::cost_functions::CollisionCheck,stomp_moveit::cost_functions::StompCostFunction)
 
 static const int MIN_KERNEL_WINDOW_SIZE = 3;
+static const double DEFAULT_CACHE_RESOLUTION = 1e-3;
 
 /**
  * @brief Convenience method that propagates the cost value at center to the window to the adjacent points.
@@ -126,7 +128,17 @@ namespace cost_functions
 CollisionCheck::CollisionCheck():
     name_("CollisionCheckPlugin"),
     robot_state_(),
-    collision_penalty_(0.0)
+    collision_penalty_(0.0),
+    num_threads_(1),
+    continuous_check_(false),
+    workers_generation_(0),
+    workers_pending_(0),
+    workers_exit_(false),
+    job_parameters_(nullptr),
+    job_rollout_number_(0),
+    job_start_(0),
+    job_end_(0),
+    job_range_size_(0)
 {
   // TODO Auto-generated constructor stub
 
@@ -134,7 +146,7 @@ CollisionCheck::CollisionCheck():
 
 CollisionCheck::~CollisionCheck()
 {
-  // TODO Auto-generated destructor stub
+  stopWorkers();
 }
 
 bool CollisionCheck::initialize(moveit::core::RobotModelConstPtr robot_model_ptr,
@@ -156,6 +168,10 @@ bool CollisionCheck::setMotionPlanRequest(const planning_scene::PlanningSceneCon
   plan_request_ = req;
   error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
 
+  // the cached results belong to the previous scene
+  state_cache_.invalidate();
+  intermediate_cache_.invalidate();
+
   // initialize collision request
   collision_request_.group_name = group_name_;
   collision_request_.cost = false;
@@ -176,15 +192,33 @@ bool CollisionCheck::setMotionPlanRequest(const planning_scene::PlanningSceneCon
     return false;
   }
 
-  // copying into intermediate robot states
-  for(auto& rs : intermediate_coll_states_)
+  // computing the motion bounds of the joints, the discrete check is used when they are not available
+  if(continuous_check_ && !segment_check_.initialize(robot_model_ptr_,*planning_scene,group_name_,*robot_state_))
+  {
+    ROS_WARN("%s continuous checks are not supported by group %s, using discrete checks",getName().c_str(),
+             group_name_.c_str());
+  }
+
+  // creating the robot states of each thread, the workers of the previous plan use the previous states
+  stopWorkers();
+  workspaces_.resize(std::max(num_threads_,1));
+  for(auto i = 0u; i < workspaces_.size(); i++)
   {
-    rs.reset(new RobotState(*robot_state_));
+    CollisionCheckWorkspace& w = workspaces_[i];
+    w.robot_state = (i == 0) ? robot_state_ : RobotStatePtr(new RobotState(*robot_state_));
+    for(auto& rs : w.intermediate_coll_states)
+    {
+      rs.reset(new RobotState(*robot_state_));
+    }
+    w.request = collision_request_;
   }
 
   // allocating arrays
   raw_costs_ = Eigen::VectorXd::Zero(config.num_timesteps);
+  state_collisions_.resize(config.num_timesteps);
+  segment_collisions_.resize(config.num_timesteps);
 
+  startWorkers();
 
   return true;
 }
@@ -207,82 +241,62 @@ bool CollisionCheck::computeCosts(const Eigen::MatrixXd& parameters,
     return false;
   }
 
-  typedef collision_detection::CollisionResult::ContactMap ContactMap;
-  typedef ContactMap::iterator ContactMapIterator;
-  typedef std::vector<collision_detection::Contact> ContactArray;
-
   // initializing result array
   costs = Eigen::VectorXd::Zero(num_timesteps);
 
   // resetting array
   raw_costs_.setZero();
-
-  // collision
-  collision_detection::CollisionRequest request = collision_request_;
-  collision_detection::CollisionResult result_world_collision, result_robot_collision;
-  std::vector<collision_detection::CollisionResult> results(2);
   validity = true;
 
-  // planning groups
-  const JointModelGroup* joint_group = robot_model_ptr_->getJointModelGroup(group_name_);
-
   if(parameters.cols()< (start_timestep + num_timesteps))
   {
     ROS_ERROR_STREAM("Size in the 'parameters' matrix is less than required");
     return false;
   }
 
-  // check for collisions at each state
-  bool skip_next_check = false;
-  for (auto t=start_timestep; t<start_timestep + num_timesteps; ++t)
+  // check for collisions at each state and between consecutive states, each thread takes a contiguous range
+  std::size_t end_timestep = start_timestep + num_timesteps;
+  int num_workers = std::min<int>(workspaces_.size(),num_timesteps);
+  if(num_workers < 2)
+  {
+    checkTimesteps(parameters,rollout_number,start_timestep,end_timestep,end_timestep,workspaces_.front());
+  }
+  else
   {
-    if(!skip_next_check)
+    // handing the ranges after the first one to the workers, those without a range only signal that they are done
+    std::size_t range_size = (num_timesteps + num_workers - 1)/num_workers;
     {
-      robot_state_->setJointGroupPositions(joint_group,parameters.col(t));
-      robot_state_->update();
-
-      // checking robot vs world (attached objects, octomap, not in urdf) collisions
-      result_world_collision.distance = std::numeric_limits<double>::max();
-
-      collision_world_->checkRobotCollision(request,
-                                            result_world_collision,
-                                            *collision_robot_,
-                                            *robot_state_,
-                                            planning_scene_->getAllowedCollisionMatrix());
-
-      collision_robot_->checkSelfCollision(request,
-                                           result_robot_collision,
-                                           *robot_state_,
-                                           planning_scene_->getAllowedCollisionMatrix());
-
-      results[0]= result_world_collision;
-      results[1] = result_robot_collision;
-      for(std::vector<collision_detection::CollisionResult>::iterator i = results.begin(); i != results.end(); i++)
-      {
-        collision_detection::CollisionResult& result = *i;
-        if(result.collision)
-        {
-          raw_costs_(t) = collision_penalty_;
-          validity = false;
-          break;
-        }
-      }
+      std::lock_guard<std::mutex> lock(workers_mutex_);
+      job_parameters_ = &parameters;
+      job_rollout_number_ = rollout_number;
+      job_start_ = start_timestep;
+      job_end_ = end_timestep;
+      job_range_size_ = range_size;
+      workers_pending_ = worker_threads_.size();
+      workers_generation_++;
     }
+    workers_start_cv_.notify_all();
 
-    // check intermediate poses to the next position (skip the last one)
-    if(t  < start_timestep + num_timesteps - 1)
+    checkTimesteps(parameters,rollout_number,start_timestep,std::min(start_timestep + range_size,end_timestep),end_timestep,
+                   workspaces_.front());
+
+    std::unique_lock<std::mutex> lock(workers_mutex_);
+    workers_done_cv_.wait(lock,[this](){ return workers_pending_ == 0; });
+  }
+
+  // a segment in collision marks both of its ends, otherwise the state check decides
+  for (auto t=start_timestep; t<end_timestep; ++t)
+  {
+    bool previous_segment = t > start_timestep && segment_collisions_[t - 1];
+    if(previous_segment || segment_collisions_[t])
     {
-      if(!checkIntermediateCollisions(parameters.col(t),parameters.col(t+1),longest_valid_joint_move_))
-      {
-        raw_costs_(t) = 1.0;
-        raw_costs_(t+1) = 1.0;
-        validity = false;
-        skip_next_check = true;
-      }
-      else
-      {
-        skip_next_check = false;
-      }
+      raw_costs_(t) = 1.0;
+      validity = false;
+    }
+    else if(state_collisions_[t])
+    {
+      raw_costs_(t) = collision_penalty_;
+      validity = false;
     }
   }
 
@@ -312,8 +326,118 @@ bool CollisionCheck::computeCosts(const Eigen::MatrixXd& parameters,
   return true;
 }
 
+void CollisionCheck::startWorkers()
+{
+  workers_exit_ = false;
+  worker_threads_.reserve(workspaces_.size() - 1);
+  for(int w = 1; w < workspaces_.size(); w++)
+  {
+    worker_threads_.emplace_back(&CollisionCheck::runWorker,this,w,workers_generation_);
+  }
+}
+
+void CollisionCheck::stopWorkers()
+{
+  if(worker_threads_.empty())
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(workers_mutex_);
+    workers_exit_ = true;
+  }
+  workers_start_cv_.notify_all();
+
+  for(auto& worker : worker_threads_)
+  {
+    worker.join();
+  }
+  worker_threads_.clear();
+}
+
+void CollisionCheck::runWorker(int w,int generation)
+{
+  while(true)
+  {
+    std::size_t first, last;
+    {
+      std::unique_lock<std::mutex> lock(workers_mutex_);
+      workers_start_cv_.wait(lock,[&](){ return workers_exit_ || workers_generation_ != generation; });
+      if(workers_exit_)
+      {
+        return;
+      }
+      generation = workers_generation_;
+      first = std::min(job_start_ + w*job_range_size_,job_end_);
+      last = std::min(first + job_range_size_,job_end_);
+    }
+
+    if(first < last)
+    {
+      checkTimesteps(*job_parameters_,job_rollout_number_,first,last,job_end_,workspaces_[w]);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(workers_mutex_);
+      workers_pending_--;
+    }
+    workers_done_cv_.notify_one();
+  }
+}
+
+void CollisionCheck::checkTimesteps(const Eigen::MatrixXd& parameters,int rollout_number,std::size_t first,
+                                    std::size_t last,std::size_t end,CollisionCheckWorkspace& workspace)
+{
+  bool skip_next_check = false;
+  for (auto t=first; t<last; ++t)
+  {
+    state_collisions_[t] = !skip_next_check && checkStateCollision(parameters.col(t),rollout_number,t,workspace);
+
+    // check intermediate poses to the next position (skip the last one)
+    segment_collisions_[t] = (t < end - 1) &&
+        !checkIntermediateCollisions(parameters.col(t),parameters.col(t+1),longest_valid_joint_move_,workspace);
+    skip_next_check = segment_collisions_[t];
+  }
+}
+
+bool CollisionCheck::checkStateCollision(const Eigen::VectorXd& joint_pose,int rollout_number,std::size_t timestep,
+                                         CollisionCheckWorkspace& workspace)
+{
+  double cached_collision;
+  if(state_cache_.lookup(joint_pose,cached_collision))
+  {
+    return cached_collision > 0;
+  }
+
+  const moveit::core::JointModelGroup* joint_group = robot_model_ptr_->getJointModelGroup(group_name_);
+  const moveit::core::RobotState& robot_state = utils::getRolloutState(kinematics_cache_,rollout_number,timestep,
+                                                                       joint_pose,joint_group,*workspace.robot_state);
+
+  // checking robot vs world (attached objects, octomap, not in urdf) collisions
+  collision_detection::CollisionResult& result = workspace.result;
+  result.clear();
+  collision_world_->checkRobotCollision(workspace.request,
+                                        result,
+                                        *collision_robot_,
+                                        robot_state,
+                                        planning_scene_->getAllowedCollisionMatrix());
+  if(!result.collision)
+  {
+    result.clear();
+    collision_robot_->checkSelfCollision(workspace.request,
+                                         result,
+                                         robot_state,
+                                         planning_scene_->getAllowedCollisionMatrix());
+  }
+
+  state_cache_.insert(joint_pose,result.collision ? 1.0 : 0.0);
+  return result.collision;
+}
+
 bool CollisionCheck::checkIntermediateCollisions(const Eigen::VectorXd& start,
-                                                           const Eigen::VectorXd& end,double longest_valid_joint_move)
+                                                           const Eigen::VectorXd& end,double longest_valid_joint_move,
+                                                           CollisionCheckWorkspace& workspace)
 {
   Eigen::VectorXd diff = end - start;
   int num_intermediate = std::ceil(((diff.cwiseAbs())/longest_valid_joint_move).maxCoeff()) - 1;
@@ -324,9 +448,9 @@ bool CollisionCheck::checkIntermediateCollisions(const Eigen::VectorXd& start,
   }
 
   // grabbing states
-  auto& start_state = intermediate_coll_states_[0];
-  auto& mid_state = intermediate_coll_states_[1];
-  auto& end_state = intermediate_coll_states_[2];
+  auto& start_state = workspace.intermediate_coll_states[0];
+  auto& mid_state = workspace.intermediate_coll_states[1];
+  auto& end_state = workspace.intermediate_coll_states[2];
 
   if(!start_state || !mid_state || !end_state)
   {
@@ -334,10 +458,13 @@ bool CollisionCheck::checkIntermediateCollisions(const Eigen::VectorXd& start,
     return false;
   }
 
+  if(continuous_check_ && segment_check_.isInitialized())
+  {
+    return segment_check_.isSegmentCollisionFree(*planning_scene_,start,end,longest_valid_joint_move,*mid_state,
+                                                 &intermediate_cache_);
+  }
+
   // setting up collision
-  auto req = collision_request_;
-  req.distance = false;
-  collision_detection::CollisionResult res;
   const moveit::core::JointModelGroup* joint_group = robot_model_ptr_->getJointModelGroup(group_name_);
   start_state->setJointGroupPositions(joint_group,start);
   end_state->setJointGroupPositions(joint_group,end);
@@ -349,7 +476,16 @@ bool CollisionCheck::checkIntermediateCollisions(const Eigen::VectorXd& start,
   {
     interval = i*dt;
     start_state->interpolate(*end_state,interval,*mid_state) ;
-    if(planning_scene_->isStateColliding(*mid_state))
+
+    double cached_collision;
+    mid_state->copyJointGroupPositions(joint_group,workspace.intermediate_pose);
+    if(!intermediate_cache_.lookup(workspace.intermediate_pose,cached_collision))
+    {
+      cached_collision = planning_scene_->isStateColliding(*mid_state) ? 1.0 : 0.0;
+      intermediate_cache_.insert(workspace.intermediate_pose,cached_collision);
+    }
+
+    if(cached_collision > 0)
     {
       return false;
     }
@@ -390,6 +526,29 @@ bool CollisionCheck::configure(const XmlRpc::XmlRpcValue& config)
     collision_penalty_ = static_cast<double>(c["collision_penalty"]);
     kernel_window_percentage_ = static_cast<double>(c["kernel_window_percentage"]);
     longest_valid_joint_move_ = static_cast<double>(c["longest_valid_joint_move"]);
+
+    // optional parallel checking
+    if(c.hasMember("num_threads"))
+    {
+      num_threads_ = static_cast<int>(c["num_threads"]);
+    }
+
+    // optional continuous checking of the segments
+    if(c.hasMember("continuous_check"))
+    {
+      continuous_check_ = static_cast<bool>(c["continuous_check"]);
+    }
+
+    // optional caching of the results
+    int cache_size = c.hasMember("cache_size") ? static_cast<int>(c["cache_size"]) : 0;
+    double cache_resolution = c.hasMember("cache_resolution") ? static_cast<double>(c["cache_resolution"]) :
+        DEFAULT_CACHE_RESOLUTION;
+    if(cache_size < 0 || !state_cache_.configure(cache_size,cache_resolution) ||
+        !intermediate_cache_.configure(cache_size,cache_resolution))
+    {
+      ROS_ERROR("%s the 'cache_size' and 'cache_resolution' parameters must be positive",getName().c_str());
+      return false;
+    }
   }
   catch(XmlRpc::XmlRpcException& e)
   {
@@ -402,7 +561,19 @@ bool CollisionCheck::configure(const XmlRpc::XmlRpcValue& config)
 
 void CollisionCheck::done(bool success,int total_iterations,double final_cost,const Eigen::MatrixXd& parameters)
 {
+  // the workers hold indices into the workspaces
+  stopWorkers();
   robot_state_.reset();
+  workspaces_.clear();
+
+  if(state_cache_.isEnabled())
+  {
+    utils::CollisionCacheStatistics state_stats = state_cache_.getStatistics();
+    utils::CollisionCacheStatistics intermediate_stats = intermediate_cache_.getStatistics();
+    ROS_DEBUG("%s cache hits/misses/evictions, states: %zu/%zu/%zu, intermediate states: %zu/%zu/%zu",
+              getName().c_str(),state_stats.hits,state_stats.misses,state_stats.evictions,
+              intermediate_stats.hits,intermediate_stats.misses,intermediate_stats.evictions);
+  }
 }
 
 } /* namespace cost_functions */
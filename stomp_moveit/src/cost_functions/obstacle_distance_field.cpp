@@ -0,0 +1,501 @@
+/**
+ * @file obstacle_distance_field.cpp
+ * @brief This defines a cost function that evaluates the distance to the world through a signed distance field.
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stomp_moveit/cost_functions/obstacle_distance_field.h>
+#include <ros/console.h>
+#include <pluginlib/class_list_macros.h>
+#include <moveit/robot_state/conversions.h>
+#include <geometric_shapes/shape_operations.h>
+#include <stomp_moveit/utils/segment_collision_check.h>
+#include <algorithm>
+#include <cmath>
+
+PLUGINLIB_EXPORT_CLASS(stomp_moveit::cost_functions::ObstacleDistanceField,stomp_moveit::cost_functions::StompCostFunction)
+static const double LONGEST_VALID_JOINT_MOVE = 0.01;
+static const double DEFAULT_RESOLUTION = 0.05;
+static const int WORKSPACE_BOUNDS_SIZE = 6;
+static const double MAX_FIELD_CELLS = 5e7;
+
+/**
+ * @brief Covers a shape with spheres placed along the longest axis of its bounding box.  Each sphere encloses its slice
+ * of the box so the union of the spheres encloses the shape.
+ * @param shape   The shape
+ * @param pose    The pose of the shape in the link frame
+ * @param spheres Receives the [center, radius] of the spheres in the link frame
+ */
+static void computeShapeSpheres(const shapes::Shape* shape,const Eigen::Affine3d& pose,
+                                std::vector<std::pair<Eigen::Vector3d,double> >& spheres)
+{
+  Eigen::Vector3d center = Eigen::Vector3d::Zero();
+  Eigen::Vector3d extents;
+  if(shape->type == shapes::MESH)
+  {
+    // meshes are not centered at their origin
+    const shapes::Mesh* mesh = static_cast<const shapes::Mesh*>(shape);
+    if(mesh->vertex_count == 0)
+    {
+      return;
+    }
+
+    Eigen::Map<const Eigen::Matrix3Xd> vertices(mesh->vertices,3,mesh->vertex_count);
+    Eigen::Vector3d min = vertices.rowwise().minCoeff();
+    Eigen::Vector3d max = vertices.rowwise().maxCoeff();
+    center = 0.5*(min + max);
+    extents = max - min;
+  }
+  else
+  {
+    extents = shapes::computeShapeExtents(shape);
+  }
+
+  if(!extents.allFinite() || extents.isZero())
+  {
+    // planes and octrees are not robot geometry
+    return;
+  }
+
+  int axis;
+  double length = extents.maxCoeff(&axis);
+  double cross_section = 0.5*std::sqrt(extents.squaredNorm() - length*length);
+  int num_spheres = std::max(1,static_cast<int>(std::ceil(length/std::max(2.0*cross_section,1e-6))));
+  double spacing = length/num_spheres;
+  double radius = std::sqrt(cross_section*cross_section + 0.25*spacing*spacing);
+
+  Eigen::Vector3d offset = Eigen::Vector3d::Zero();
+  for(int i = 0; i < num_spheres; i++)
+  {
+    offset(axis) = -0.5*length + (i + 0.5)*spacing;
+    spheres.push_back(std::make_pair(pose*(center + offset),radius));
+  }
+}
+
+/**
+ * @brief Adds the occupied cells of an octree to a distance field.  The octree is added directly when it is in the
+ * planning frame, otherwise its leaves are sampled at the field resolution and moved to the planning frame.
+ * @param octree  The octree
+ * @param pose    The pose of the octree in the planning frame
+ * @param field   The distance field
+ */
+static void addOcTreeToField(const octomap::OcTree& octree,const Eigen::Affine3d& pose,
+                             distance_field::PropagationDistanceField& field)
+{
+  if(pose.isApprox(Eigen::Affine3d::Identity()))
+  {
+    field.addOcTreeToField(&octree);
+    return;
+  }
+
+  EigenSTL::vector_Vector3d points;
+  for(auto leaf = octree.begin_leafs(); leaf != octree.end_leafs(); ++leaf)
+  {
+    if(!octree.isNodeOccupied(*leaf))
+    {
+      continue;
+    }
+
+    double size = leaf.getSize();
+    int num_samples = std::max(1,static_cast<int>(std::ceil(size/field.getResolution())));
+    double step = size/num_samples;
+    Eigen::Vector3d corner = Eigen::Vector3d(leaf.getX(),leaf.getY(),leaf.getZ()) - Eigen::Vector3d::Constant(0.5*size);
+    for(int i = 0; i < num_samples; i++)
+    {
+      for(int j = 0; j < num_samples; j++)
+      {
+        for(int k = 0; k < num_samples; k++)
+        {
+          points.push_back(pose*(corner + step*Eigen::Vector3d(i + 0.5,j + 0.5,k + 0.5)));
+        }
+      }
+    }
+  }
+
+  field.addPointsToField(points);
+}
+
+namespace stomp_moveit
+{
+namespace cost_functions
+{
+
+ObstacleDistanceField::ObstacleDistanceField() :
+    name_("ObstacleDistanceField"),
+    robot_state_(),
+    max_sphere_radius_(0.0),
+    max_distance_(0.0),
+    longest_valid_joint_move_(LONGEST_VALID_JOINT_MOVE),
+    resolution_(DEFAULT_RESOLUTION)
+{
+
+}
+
+ObstacleDistanceField::~ObstacleDistanceField()
+{
+
+}
+
+bool ObstacleDistanceField::initialize(moveit::core::RobotModelConstPtr robot_model_ptr,
+                                       const std::string& group_name, XmlRpc::XmlRpcValue& config)
+{
+  robot_model_ptr_ = robot_model_ptr;
+  group_name_ = group_name;
+  return configure(config);
+}
+
+bool ObstacleDistanceField::configure(const XmlRpc::XmlRpcValue& config)
+{
+  using namespace XmlRpc;
+
+  try
+  {
+    // check parameter presence
+    auto members = {"cost_weight" ,"max_distance"};
+    for(auto& m : members)
+    {
+      if(!config.hasMember(m))
+      {
+        ROS_ERROR("%s failed to find the '%s' parameter",getName().c_str(),m);
+        return false;
+      }
+    }
+
+    XmlRpcValue c = config;
+    max_distance_ = static_cast<double>(c["max_distance"]);
+    cost_weight_ = static_cast<double>(c["cost_weight"]);
+    longest_valid_joint_move_ = c.hasMember("longest_valid_joint_move") ? static_cast<double>(c["longest_valid_joint_move"]):LONGEST_VALID_JOINT_MOVE;
+    resolution_ = c.hasMember("resolution") ? static_cast<double>(c["resolution"]) : DEFAULT_RESOLUTION;
+
+    if(!c.hasMember("longest_valid_joint_move"))
+    {
+      ROS_WARN("%s using default value for 'longest_valid_joint_move' of %f",getName().c_str(),longest_valid_joint_move_);
+    }
+
+    if(max_distance_ <= 0 || resolution_ <= 0)
+    {
+      ROS_ERROR("%s the 'max_distance' and 'resolution' parameters must be positive",getName().c_str());
+      return false;
+    }
+
+    // optional field bounds
+    workspace_bounds_.clear();
+    if(c.hasMember("workspace_bounds"))
+    {
+      XmlRpcValue bounds_param = c["workspace_bounds"];
+      if((bounds_param.getType() != XmlRpcValue::TypeArray) || bounds_param.size() != WORKSPACE_BOUNDS_SIZE)
+      {
+        ROS_ERROR("%s the 'workspace_bounds' parameter must be an array of %i values",getName().c_str(),
+                  WORKSPACE_BOUNDS_SIZE);
+        return false;
+      }
+
+      for(auto i = 0u; i < bounds_param.size(); i++)
+      {
+        workspace_bounds_.push_back(static_cast<double>(bounds_param[i]));
+      }
+
+      for(auto i = 0u; i < 3; i++)
+      {
+        if(workspace_bounds_[i] >= workspace_bounds_[i + 3])
+        {
+          ROS_ERROR("%s the 'workspace_bounds' minimum corner must be below the maximum corner",getName().c_str());
+          return false;
+        }
+      }
+    }
+  }
+  catch(XmlRpc::XmlRpcException& e)
+  {
+    ROS_ERROR("%s failed to parse configuration parameters",name_.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool ObstacleDistanceField::setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                                 const moveit_msgs::MotionPlanRequest &req,
+                                                 const stomp_core::StompConfiguration &config,
+                                                 moveit_msgs::MoveItErrorCodes& error_code)
+{
+  using namespace moveit::core;
+
+  planning_scene_ = planning_scene;
+  plan_request_ = req;
+  error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+
+  // storing robot state
+  robot_state_.reset(new RobotState(robot_model_ptr_));
+  if(!robotStateMsgToRobotState(req.start_state,*robot_state_,true))
+  {
+    ROS_ERROR("%s Failed to get current robot state from request",getName().c_str());
+    return false;
+  }
+
+  createCollisionSpheres(*robot_state_);
+  if(!createDistanceField(*robot_state_))
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+    return false;
+  }
+
+  return true;
+}
+
+void ObstacleDistanceField::createCollisionSpheres(const moveit::core::RobotState& state)
+{
+  using namespace moveit::core;
+
+  collision_spheres_.clear();
+  max_sphere_radius_ = 0.0;
+  const JointModelGroup* joint_group = robot_model_ptr_->getJointModelGroup(group_name_);
+
+  // links without geometry may still carry attached bodies
+  const std::vector<const LinkModel*>& links = joint_group->getUpdatedLinkModels();
+
+  std::vector<const AttachedBody*> attached_bodies;
+  state.getAttachedBodies(attached_bodies);
+
+  std::vector<std::pair<Eigen::Vector3d,double> > spheres;
+  for(const LinkModel* link : links)
+  {
+    spheres.clear();
+    const std::vector<shapes::ShapeConstPtr>& shapes = link->getShapes();
+    for(auto i = 0u; i < shapes.size(); i++)
+    {
+      computeShapeSpheres(shapes[i].get(),link->getCollisionOriginTransforms()[i],spheres);
+    }
+
+    for(const AttachedBody* body : attached_bodies)
+    {
+      if(body->getAttachedLink() != link)
+      {
+        continue;
+      }
+
+      for(auto i = 0u; i < body->getShapes().size(); i++)
+      {
+        computeShapeSpheres(body->getShapes()[i].get(),body->getFixedTransforms()[i],spheres);
+      }
+    }
+
+    for(const auto& s : spheres)
+    {
+      collision_spheres_.push_back({link,s.first,s.second});
+      max_sphere_radius_ = std::max(max_sphere_radius_,s.second);
+    }
+  }
+
+  ROS_DEBUG("%s approximated %zu links with %zu spheres",getName().c_str(),links.size(),collision_spheres_.size());
+}
+
+bool ObstacleDistanceField::createDistanceField(const moveit::core::RobotState& state)
+{
+  Eigen::Vector3d min, max;
+  if(workspace_bounds_.empty())
+  {
+    // enclosing every pose the links of the group can reach from the root link, out to the propagation distance
+    const moveit::core::LinkModel* root_link = robot_model_ptr_->getRootLink();
+    const moveit::core::JointModelGroup* joint_group = robot_model_ptr_->getJointModelGroup(group_name_);
+    double reach = 0;
+    for(const moveit::core::LinkModel* link : joint_group->getUpdatedLinkModels())
+    {
+      reach = std::max(reach,utils::computeChainReach(root_link,link) + utils::computeLinkRadius(link,state));
+    }
+    reach += max_distance_ + max_sphere_radius_;
+
+    Eigen::Vector3d root = state.getGlobalLinkTransform(root_link).translation();
+    min = root - Eigen::Vector3d::Constant(reach);
+    max = root + Eigen::Vector3d::Constant(reach);
+  }
+  else
+  {
+    min = Eigen::Vector3d(workspace_bounds_[0],workspace_bounds_[1],workspace_bounds_[2]);
+    max = Eigen::Vector3d(workspace_bounds_[3],workspace_bounds_[4],workspace_bounds_[5]);
+  }
+
+  /* the distances are measured from the sphere centers, propagating them past 'max_distance' by the largest radius
+   * keeps the clearance of the sphere surfaces from saturating below 'max_distance'.  The interpolation needs at least
+   * two cells along each axis.
+   */
+  Eigen::Vector3d size = (max - min).cwiseMax(2.0*resolution_);
+  double num_cells = (size/resolution_).array().ceil().prod();
+  if(num_cells > MAX_FIELD_CELLS)
+  {
+    ROS_ERROR("%s the distance field would have %.0f cells, more than the limit of %.0f.  Set 'workspace_bounds' or "
+              "increase 'resolution'",getName().c_str(),num_cells,MAX_FIELD_CELLS);
+    return false;
+  }
+
+  distance_field_.reset(new distance_field::PropagationDistanceField(size.x(),size.y(),size.z(),resolution_,
+                                                                     min.x(),min.y(),min.z(),
+                                                                     max_distance_ + max_sphere_radius_,true));
+
+  collision_detection::WorldConstPtr world = planning_scene_->getWorld();
+  for(auto it = world->begin(); it != world->end(); it++)
+  {
+    const collision_detection::World::Object& object = *it->second;
+    for(auto i = 0u; i < object.shapes_.size(); i++)
+    {
+      const shapes::Shape* shape = object.shapes_[i].get();
+      if(shape->type == shapes::OCTREE)
+      {
+        addOcTreeToField(*static_cast<const shapes::OcTree*>(shape)->octree,object.shape_poses_[i],*distance_field_);
+      }
+      else
+      {
+        distance_field_->addShapeToField(shape,object.shape_poses_[i]);
+      }
+    }
+  }
+
+  ROS_DEBUG("%s created a distance field of %i x %i x %i cells",getName().c_str(),distance_field_->getXNumCells(),
+            distance_field_->getYNumCells(),distance_field_->getZNumCells());
+  return true;
+}
+
+double ObstacleDistanceField::getDistance(const Eigen::Vector3d& point) const
+{
+  const distance_field::PropagationDistanceField& field = *distance_field_;
+  Eigen::Vector3d origin(field.getOriginX(),field.getOriginY(),field.getOriginZ());
+  Eigen::Vector3i num_cells(field.getXNumCells(),field.getYNumCells(),field.getZNumCells());
+
+  // the cell centers are at origin + index*resolution
+  Eigen::Vector3d position = (point - origin)/field.getResolution();
+  Eigen::Vector3i index;
+  Eigen::Vector3d weight;
+  for(int i = 0; i < 3; i++)
+  {
+    if(position(i) < 0 || position(i) > num_cells(i) - 1)
+    {
+      // the world outside of the field is not represented
+      return field.getUninitializedDistance();
+    }
+
+    index(i) = std::min(static_cast<int>(std::floor(position(i))),num_cells(i) - 2);
+    weight(i) = position(i) - index(i);
+  }
+
+  double distance = 0;
+  for(int corner = 0; corner < 8; corner++)
+  {
+    int dx = corner & 1, dy = (corner >> 1) & 1, dz = (corner >> 2) & 1;
+    double w = (dx ? weight.x() : 1 - weight.x())*(dy ? weight.y() : 1 - weight.y())*(dz ? weight.z() : 1 - weight.z());
+    distance += w*field.getDistance(index.x() + dx,index.y() + dy,index.z() + dz);
+  }
+
+  return distance;
+}
+
+double ObstacleDistanceField::computeClearance(const moveit::core::RobotState& state) const
+{
+  // the clearance of every sphere is clamped at 'max_distance'
+  double clearance = max_distance_;
+  for(const auto& s : collision_spheres_)
+  {
+    Eigen::Vector3d center = state.getGlobalLinkTransform(s.link)*s.center;
+    clearance = std::min(clearance,getDistance(center) - s.radius);
+  }
+
+  return clearance;
+}
+
+bool ObstacleDistanceField::computeCosts(const Eigen::MatrixXd& parameters, std::size_t start_timestep,
+                                         std::size_t num_timesteps, int iteration_number, int rollout_number,
+                                         Eigen::VectorXd& costs, bool& validity)
+{
+  if(!robot_state_ || !distance_field_)
+  {
+    ROS_ERROR("%s Robot State has not been updated",getName().c_str());
+    return false;
+  }
+
+  if(parameters.cols()<start_timestep + num_timesteps)
+  {
+    ROS_ERROR_STREAM("Size in the 'parameters' matrix is less than required");
+    return false;
+  }
+
+  // allocating
+  costs = Eigen::VectorXd::Zero(num_timesteps);
+  const moveit::core::JointModelGroup* joint_group = robot_model_ptr_->getJointModelGroup(group_name_);
+
+  bool skip_next_check = false;
+  validity = true;
+  for (auto t=start_timestep; t<start_timestep + num_timesteps; ++t)
+  {
+    double dist = -1.0;
+    if(!skip_next_check)
+    {
+      dist = computeClearance(utils::getRolloutState(kinematics_cache_,rollout_number,t,parameters.col(t),joint_group,
+                                                     *robot_state_));
+    }
+    skip_next_check = false;
+    if(dist >= max_distance_)
+    {
+      costs(t) = 0; // away from obstacle
+    }
+    else if(dist < 0)
+    {
+      costs(t) = 1.0; // in collision
+      validity = false;
+    }
+    else
+    {
+      costs(t) = (max_distance_ - dist)/max_distance_;
+    }
+
+    // check intermediate poses to the next position (skip the last one)
+    if(t  < start_timestep + num_timesteps - 1)
+    {
+      Eigen::VectorXd diff = parameters.col(t+1) - parameters.col(t);
+      int num_intermediate = std::ceil(((diff.cwiseAbs())/longest_valid_joint_move_).maxCoeff()) - 1;
+      for(int i = 1; i <= num_intermediate; i++)
+      {
+        intermediate_pose_ = parameters.col(t) + (static_cast<double>(i)/(num_intermediate + 1))*diff;
+        robot_state_->setJointGroupPositions(joint_group,intermediate_pose_);
+        robot_state_->updateLinkTransforms();
+        if(computeClearance(*robot_state_) < 0)
+        {
+          costs(t) = 1.0;
+          costs(t+1) = 1.0;
+          validity = false;
+          skip_next_check = true;
+          break;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+void ObstacleDistanceField::done(bool success,int total_iterations,double final_cost,const Eigen::MatrixXd& parameters)
+{
+  robot_state_.reset();
+  distance_field_.reset();
+}
+
+} /* namespace cost_functions */
+} /* namespace stomp_moveit */
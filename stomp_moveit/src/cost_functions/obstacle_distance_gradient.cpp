@@ -31,6 +31,7 @@
 
 PLUGINLIB_EXPORT_CLASS(stomp_moveit::cost_functions::ObstacleDistanceGradient,stomp_moveit::cost_functions::StompCostFunction)
 static const double LONGEST_VALID_JOINT_MOVE = 0.01;
+static const double DEFAULT_CACHE_RESOLUTION = 1e-3;
 
 namespace stomp_moveit
 {
@@ -39,7 +40,8 @@ namespace cost_functions
 
 ObstacleDistanceGradient::ObstacleDistanceGradient() :
     name_("ObstacleDistanceGradient"),
-    robot_state_()
+    robot_state_(),
+    continuous_check_(false)
 {
 
 }
@@ -89,6 +91,20 @@ bool ObstacleDistanceGradient::configure(const XmlRpc::XmlRpcValue& config)
     {
       ROS_WARN("%s using default value for 'longest_valid_joint_move' of %f",getName().c_str(),longest_valid_joint_move_);
     }
+
+    // optional continuous checking of the segments
+    continuous_check_ = c.hasMember("continuous_check") ? static_cast<bool>(c["continuous_check"]) : false;
+
+    // optional caching of the results
+    int cache_size = c.hasMember("cache_size") ? static_cast<int>(c["cache_size"]) : 0;
+    double cache_resolution = c.hasMember("cache_resolution") ? static_cast<double>(c["cache_resolution"]) :
+        DEFAULT_CACHE_RESOLUTION;
+    if(cache_size < 0 || !distance_cache_.configure(cache_size,cache_resolution) ||
+        !intermediate_cache_.configure(cache_size,cache_resolution))
+    {
+      ROS_ERROR("%s the 'cache_size' and 'cache_resolution' parameters must be positive",getName().c_str());
+      return false;
+    }
   }
   catch(XmlRpc::XmlRpcException& e)
   {
@@ -110,6 +126,10 @@ bool ObstacleDistanceGradient::setMotionPlanRequest(const planning_scene::Planni
   plan_request_ = req;
   error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
 
+  // the cached results belong to the previous scene
+  distance_cache_.invalidate();
+  intermediate_cache_.invalidate();
+
   // storing robot state
   robot_state_.reset(new RobotState(robot_model_ptr_));
 
@@ -125,6 +145,13 @@ bool ObstacleDistanceGradient::setMotionPlanRequest(const planning_scene::Planni
     rs.reset(new RobotState(*robot_state_));
   }
 
+  // computing the motion bounds of the joints, the discrete check is used when they are not available
+  if(continuous_check_ && !segment_check_.initialize(robot_model_ptr_,*planning_scene,group_name_,*robot_state_))
+  {
+    ROS_WARN("%s continuous checks are not supported by group %s, using discrete checks",getName().c_str(),
+             group_name_.c_str());
+  }
+
   return true;
 }
 
@@ -160,13 +187,17 @@ bool ObstacleDistanceGradient::computeCosts(const Eigen::MatrixXd& parameters, s
 
     if(!skip_next_check)
     {
-      collision_result_.clear();
-      robot_state_->setJointGroupPositions(joint_group,parameters.col(t));
-      robot_state_->update();
-      collision_result_.distance = max_distance_;
-
-      planning_scene_->checkSelfCollision(collision_request_,collision_result_,*robot_state_,planning_scene_->getAllowedCollisionMatrix());
-      dist = collision_result_.collision ? -1.0 :collision_result_.distance ;
+      if(!distance_cache_.lookup(parameters.col(t),dist))
+      {
+        collision_result_.clear();
+        const moveit::core::RobotState& state = utils::getRolloutState(kinematics_cache_,rollout_number,t,
+                                                                       parameters.col(t),joint_group,*robot_state_);
+        collision_result_.distance = max_distance_;
+
+        planning_scene_->checkSelfCollision(collision_request_,collision_result_,state,planning_scene_->getAllowedCollisionMatrix());
+        dist = collision_result_.collision ? -1.0 :collision_result_.distance ;
+        distance_cache_.insert(parameters.col(t),dist);
+      }
 
       if(dist >= max_distance_)
       {
@@ -228,6 +259,12 @@ bool ObstacleDistanceGradient::checkIntermediateCollisions(const Eigen::VectorXd
     return false;
   }
 
+  if(continuous_check_ && segment_check_.isInitialized())
+  {
+    return segment_check_.isSegmentCollisionFree(*planning_scene_,start,end,longest_valid_joint_move,*mid_state,
+                                                 &intermediate_cache_);
+  }
+
   // setting up collision
   auto req = collision_request_;
   req.distance = false;
@@ -243,7 +280,16 @@ bool ObstacleDistanceGradient::checkIntermediateCollisions(const Eigen::VectorXd
   {
     interval = i*dt;
     start_state->interpolate(*end_state,interval,*mid_state) ;
-    if(planning_scene_->isStateColliding(*mid_state))
+
+    double cached_collision;
+    mid_state->copyJointGroupPositions(joint_group,intermediate_pose_);
+    if(!intermediate_cache_.lookup(intermediate_pose_,cached_collision))
+    {
+      cached_collision = planning_scene_->isStateColliding(*mid_state) ? 1.0 : 0.0;
+      intermediate_cache_.insert(intermediate_pose_,cached_collision);
+    }
+
+    if(cached_collision > 0)
     {
       return false;
     }
@@ -255,6 +301,15 @@ bool ObstacleDistanceGradient::checkIntermediateCollisions(const Eigen::VectorXd
 void ObstacleDistanceGradient::done(bool success,int total_iterations,double final_cost,const Eigen::MatrixXd& parameters)
 {
   robot_state_.reset();
+
+  if(distance_cache_.isEnabled())
+  {
+    utils::CollisionCacheStatistics distance_stats = distance_cache_.getStatistics();
+    utils::CollisionCacheStatistics intermediate_stats = intermediate_cache_.getStatistics();
+    ROS_DEBUG("%s cache hits/misses/evictions, states: %zu/%zu/%zu, intermediate states: %zu/%zu/%zu",
+              getName().c_str(),distance_stats.hits,distance_stats.misses,distance_stats.evictions,
+              intermediate_stats.hits,intermediate_stats.misses,intermediate_stats.evictions);
+  }
 }
 
 } /* namespace cost_functions */
@@ -25,6 +25,7 @@
  */
 #include <stomp_moveit/noise_generators/normal_distribution_sampling.h>
 #include <stomp_moveit/utils/multivariate_gaussian.h>
+#include <stomp_core/matrix_cache.h>
 #include <XmlRpcException.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/console.h>
@@ -44,7 +45,8 @@ namespace noise_generators
 {
 
 NormalDistributionSampling::NormalDistributionSampling():
-    name_("NormalDistributionSampling")
+    name_("NormalDistributionSampling"),
+    seed_(0)
 {
   // TODO Auto-generated constructor stub
 
@@ -95,6 +97,12 @@ bool NormalDistributionSampling::configure(const XmlRpc::XmlRpcValue& config)
     {
       stddev_[i] = static_cast<double>(stddev_param[i]);
     }
+
+    // optional seed of the random streams
+    if(c.hasMember("seed"))
+    {
+      seed_ = static_cast<int>(c["seed"]);
+    }
   }
   catch(XmlRpc::XmlRpcException& e)
   {
@@ -112,34 +120,42 @@ bool NormalDistributionSampling::setMotionPlanRequest(const planning_scene::Plan
 {
   using namespace Eigen;
 
-  auto fill_diagonal = [](Eigen::MatrixXd& m,double coeff,int diag_index)
-  {
-    std::size_t size = m.rows() - std::abs(diag_index);
-    m.diagonal(diag_index) = VectorXd::Constant(size,coeff);
-  };
-
-  // creating finite difference acceleration matrix
+  // creating the covariance from the finite difference acceleration matrix, it is scaled so it does not depend on dt
   std::size_t num_timesteps = config.num_timesteps;
-  Eigen::MatrixXd A = MatrixXd::Zero(num_timesteps,num_timesteps);
-  int num_elements = (int((ACC_MATRIX_DIAGONAL_INDICES.size() -1)/2.0) + 1)* num_timesteps ;
-  for(auto i = 0u; i < ACC_MATRIX_DIAGONAL_INDICES.size() ; i++)
+  stomp_core::MatrixConstPtr covariance = stomp_core::getCachedMatrix(
+      "noise_generators/acceleration_covariance",num_timesteps,1.0,stomp_core::DerivativeOrders::STOMP_ACCELERATION,
+      [num_timesteps](Eigen::MatrixXd& covariance)
   {
-    fill_diagonal(A,ACC_MATRIX_DIAGONAL_VALUES[i],ACC_MATRIX_DIAGONAL_INDICES[i]);
-  }
+    auto fill_diagonal = [](Eigen::MatrixXd& m,double coeff,int diag_index)
+    {
+      std::size_t size = m.rows() - std::abs(diag_index);
+      m.diagonal(diag_index) = VectorXd::Constant(size,coeff);
+    };
+
+    // creating finite difference acceleration matrix
+    Eigen::MatrixXd A = MatrixXd::Zero(num_timesteps,num_timesteps);
+    for(auto i = 0u; i < ACC_MATRIX_DIAGONAL_INDICES.size() ; i++)
+    {
+      fill_diagonal(A,ACC_MATRIX_DIAGONAL_VALUES[i],ACC_MATRIX_DIAGONAL_INDICES[i]);
+    }
 
-  // create and scale covariance matrix
-  Eigen::MatrixXd covariance = MatrixXd::Identity(num_timesteps,num_timesteps);
-  covariance = A.transpose() * A;
-  covariance = covariance.fullPivLu().inverse();
-  double max_val = covariance.array().abs().matrix().maxCoeff();
-  covariance /= max_val;
+    // create and scale covariance matrix
+    covariance = A.transpose() * A;
+    covariance = covariance.fullPivLu().inverse();
+    double max_val = covariance.array().abs().matrix().maxCoeff();
+    covariance /= max_val;
+  });
 
-  // create random generators
-  rand_generators_.resize(stddev_.size());
-  for(auto& r: rand_generators_)
+  stomp_core::MatrixConstPtr covariance_cholesky = stomp_core::getCachedMatrix(
+      "noise_generators/acceleration_covariance_cholesky",num_timesteps,1.0,
+      stomp_core::DerivativeOrders::STOMP_ACCELERATION,[&covariance](Eigen::MatrixXd& cholesky)
   {
-    r.reset(new utils::MultivariateGaussian(VectorXd::Zero(num_timesteps),covariance));
-  }
+    cholesky = covariance->llt().matrixL();
+  });
+
+  // create the random generator, the dimensions only differ in the random stream they sample from
+  rand_generator_.reset(new utils::MultivariateGaussian(VectorXd::Zero(num_timesteps),*covariance,*covariance_cholesky,
+                                                        seed_));
 
   // preallocating noise data
   raw_noise_.resize(config.num_timesteps);
@@ -164,9 +180,11 @@ bool NormalDistributionSampling::generateNoise(const Eigen::MatrixXd& parameters
   }
 
 
+  stomp_core::RandomStream stream;
   for(auto d = 0u; d < parameters.rows() ; d++)
   {
-    rand_generators_[d]->sample(raw_noise_);
+    stream.reset(seed_,iteration_number,rollout_number,d);
+    rand_generator_->sample(raw_noise_,stream);
     noise.row(d).transpose() = stddev_[d] * raw_noise_;
     parameters_noise.row(d) = parameters.row(d) + noise.row(d);
   }
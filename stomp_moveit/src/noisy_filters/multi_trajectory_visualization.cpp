@@ -237,8 +237,9 @@ bool MultiTrajectoryVisualization::filter(std::size_t start_timestep,
   std::string tool_link = joint_group->getLinkModelNames().back();
   for(auto t = 0u; t < parameters.cols();t++)
   {
-    state_->setJointGroupPositions(joint_group,parameters.col(t));
-    Eigen::Affine3d tool_pos = state_->getFrameTransform(tool_link);
+    const moveit::core::RobotState& state = utils::getRolloutState(kinematics_cache_,rollout_number,t,parameters.col(t),
+                                                                   joint_group,*state_);
+    Eigen::Affine3d tool_pos = state.getFrameTransform(tool_link);
     tool_traj_line_(0,t) = tool_pos.translation()(0);
     tool_traj_line_(1,t) = tool_pos.translation()(1);
     tool_traj_line_(2,t) = tool_pos.translation()(2);
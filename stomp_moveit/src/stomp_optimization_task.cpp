@@ -24,6 +24,7 @@
  * limitations under the License.
  */
 #include <stdexcept>
+#include <moveit/robot_state/conversions.h>
 #include "stomp_moveit/stomp_optimization_task.h"
 
 using PluginConfigs = std::vector< std::pair<std::string,XmlRpc::XmlRpcValue> >;
@@ -174,6 +175,17 @@ bool loadPlugins(const PluginData plugin_data,
   return true;
 }
 
+/**
+ * @brief Gets the buffer that receives the costs of each cost function.  There is one per thread so that the cost
+ * methods can be called concurrently while the buffer keeps its storage between calls.
+ * @return The buffer of the calling thread
+ */
+static Eigen::VectorXd& getStateCostsBuffer()
+{
+  static thread_local Eigen::VectorXd state_costs;
+  return state_costs;
+}
+
 namespace stomp_moveit
 {
 
@@ -181,8 +193,10 @@ StompOptimizationTask::StompOptimizationTask(
     moveit::core::RobotModelConstPtr robot_model_ptr,
     std::string group_name,
     const XmlRpc::XmlRpcValue& config):
+        group_name_(group_name),
         robot_model_ptr_(robot_model_ptr),
-        group_name_(group_name)
+        config_(config),
+        request_count_(0)
 {
   // initializing plugin loaders
   cost_function_loader_.reset(new CostFunctionLoader("stomp_moveit", "stomp_moveit::cost_functions::StompCostFunction"));
@@ -238,6 +252,23 @@ StompOptimizationTask::StompOptimizationTask(
   {
     ROS_WARN("StompOptimizationTask/%s failed to load '%s' plugins from yaml",group_name.c_str(),UPDATE_FILTERS_FIELD.c_str());
   }
+
+  // sharing the forward kinematics of the rollouts with the plugins
+  kinematics_cache_.reset(new utils::ForwardKinematicsCache(robot_model_ptr_,group_name_));
+  for(auto p : cost_functions_)
+  {
+    p->setKinematicsCache(kinematics_cache_);
+  }
+
+  for(auto p: noisy_filters_)
+  {
+    p->setKinematicsCache(kinematics_cache_);
+  }
+
+  for(auto p: update_filters_)
+  {
+    p->setKinematicsCache(kinematics_cache_);
+  }
 }
 
 StompOptimizationTask::~StompOptimizationTask()
@@ -265,14 +296,14 @@ bool StompOptimizationTask::computeNoisyCosts(const Eigen::MatrixXd& parameters,
                                          Eigen::VectorXd& costs,
                                          bool& validity)
 {
-  Eigen::MatrixXd cost_matrix = Eigen::MatrixXd::Zero(num_timesteps,cost_functions_.size());
-  Eigen::VectorXd state_costs = Eigen::VectorXd::Zero(num_timesteps);
+  // accumulating the weighted costs in place, the buffers keep their storage between calls
+  Eigen::VectorXd& state_costs = getStateCostsBuffer();
+  costs.setZero(num_timesteps);
+  state_costs.setZero(num_timesteps);
   validity = true;
-  for(auto i = 0u; i < cost_functions_.size(); i++ )
+  for(const auto& cf : cost_functions_)
   {
     bool valid;
-    auto cf = cost_functions_[i];
-
     if(!cf->computeCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,state_costs,valid))
     {
       return false;
@@ -280,9 +311,8 @@ bool StompOptimizationTask::computeNoisyCosts(const Eigen::MatrixXd& parameters,
 
     validity &= valid;
 
-    cost_matrix.col(i) = state_costs * cf->getWeight();
+    costs += state_costs * cf->getWeight();
   }
-  costs = cost_matrix.rowwise().sum();
   return true;
 }
 
@@ -293,14 +323,14 @@ bool StompOptimizationTask::computeCosts(const Eigen::MatrixXd& parameters,
                                          Eigen::VectorXd& costs,
                                          bool& validity)
 {
-  Eigen::MatrixXd cost_matrix = Eigen::MatrixXd::Zero(num_timesteps,cost_functions_.size());
-  Eigen::VectorXd state_costs = Eigen::VectorXd::Zero(num_timesteps);
+  // accumulating the weighted costs in place, the buffers keep their storage between calls
+  Eigen::VectorXd& state_costs = getStateCostsBuffer();
+  costs.setZero(num_timesteps);
+  state_costs.setZero(num_timesteps);
   validity = true;
-  for(auto i = 0u; i < cost_functions_.size(); i++ )
+  for(const auto& cf : cost_functions_)
   {
     bool valid;
-    auto cf = cost_functions_[i];
-
     if(!cf->computeCosts(parameters,start_timestep,num_timesteps,iteration_number,cf->getOptimizedIndex(),state_costs,valid))
     {
       return false;
@@ -308,9 +338,8 @@ bool StompOptimizationTask::computeCosts(const Eigen::MatrixXd& parameters,
 
     validity &= valid;
 
-    cost_matrix.col(i) = state_costs * cf->getWeight();
+    costs += state_costs * cf->getWeight();
   }
-  costs = cost_matrix.rowwise().sum();
   return true;
 }
 
@@ -319,6 +348,103 @@ bool StompOptimizationTask::setMotionPlanRequest(const planning_scene::PlanningS
                                         const stomp_core::StompConfiguration &config,
                                         moveit_msgs::MoveItErrorCodes& error_code)
 {
+  planning_scene_ptr_ = planning_scene;
+  plan_request_ = req;
+  stomp_config_ = config;
+  request_count_++;
+  return setPluginsMotionPlanRequest(planning_scene,req,config,error_code);
+}
+
+bool StompOptimizationTask::setNumTimesteps(int num_timesteps)
+{
+  if(!planning_scene_ptr_ || num_timesteps < 2)
+  {
+    return false;
+  }
+
+  // same trajectory duration sampled with a different number of timesteps
+  stomp_core::StompConfiguration config = stomp_config_;
+  config.num_timesteps = num_timesteps;
+  config.delta_t = stomp_config_.delta_t*(stomp_config_.num_timesteps - 1)/(num_timesteps - 1);
+
+  moveit_msgs::MoveItErrorCodes error_code;
+  return setPluginsMotionPlanRequest(planning_scene_ptr_,plan_request_,config,error_code);
+}
+
+stomp_core::TaskPtr StompOptimizationTask::clone() const
+{
+  boost::shared_ptr<StompOptimizationTask> task;
+  try
+  {
+    task.reset(new StompOptimizationTask(robot_model_ptr_,group_name_,config_));
+  }
+  catch(std::logic_error& e)
+  {
+    ROS_ERROR("StompOptimizationTask/%s failed to clone the task: %s",group_name_.c_str(),e.what());
+    return stomp_core::TaskPtr();
+  }
+
+  if(!updateClone(*task))
+  {
+    return stomp_core::TaskPtr();
+  }
+
+  return task;
+}
+
+bool StompOptimizationTask::updateClone(stomp_core::Task& clone) const
+{
+  StompOptimizationTask* task = dynamic_cast<StompOptimizationTask*>(&clone);
+  if(!task || task->group_name_ != group_name_)
+  {
+    return false;
+  }
+
+  if(!planning_scene_ptr_)
+  {
+    return true;
+  }
+
+  // the plugins are only set up again when the request or the number of timesteps changed
+  bool new_request = task->request_count_ != request_count_ || task->planning_scene_ptr_ != planning_scene_ptr_;
+  if(!new_request && task->active_config_.num_timesteps == active_config_.num_timesteps &&
+      task->active_config_.delta_t == active_config_.delta_t)
+  {
+    return true;
+  }
+
+  task->planning_scene_ptr_ = planning_scene_ptr_;
+  task->plan_request_ = plan_request_;
+  task->stomp_config_ = stomp_config_;
+  task->request_count_ = request_count_;
+
+  moveit_msgs::MoveItErrorCodes error_code;
+  if(!task->setPluginsMotionPlanRequest(planning_scene_ptr_,plan_request_,active_config_,error_code))
+  {
+    ROS_ERROR("StompOptimizationTask/%s failed to set the plan request on the cloned task",group_name_.c_str());
+    task->request_count_ = 0;
+    return false;
+  }
+
+  return true;
+}
+
+bool StompOptimizationTask::setPluginsMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                        const moveit_msgs::MotionPlanRequest &req,
+                                        const stomp_core::StompConfiguration &config,
+                                        moveit_msgs::MoveItErrorCodes& error_code)
+{
+  // the states of the previous plan no longer apply
+  moveit::core::RobotState start_state(robot_model_ptr_);
+  if(!moveit::core::robotStateMsgToRobotState(req.start_state,start_state,true))
+  {
+    ROS_ERROR("StompOptimizationTask/%s failed to get the start state from the request",group_name_.c_str());
+    error_code.val = moveit_msgs::MoveItErrorCodes::INVALID_ROBOT_STATE;
+    return false;
+  }
+  active_config_ = config;
+  kinematics_cache_->reset(start_state,config.num_rollouts,config.num_timesteps);
+
   for(auto p: noise_generators_)
   {
     if(!p->setMotionPlanRequest(planning_scene,req,config,error_code))
@@ -448,6 +574,10 @@ void StompOptimizationTask::done(bool success,int total_iterations,double final_
   {
     p->done(success,total_iterations,final_cost,parameters);
   }
+
+  std::size_t hits, misses;
+  kinematics_cache_->getStatistics(hits,misses);
+  ROS_DEBUG("StompOptimizationTask/%s forward kinematics hits/misses: %zu/%zu",group_name_.c_str(),hits,misses);
 }
 
 } /* namespace stomp_moveit */
@@ -34,7 +34,7 @@
 
 
 static const std::string DESCRIPTION = "STOMP";
-static const double TIMEOUT_INTERVAL = 0.05;
+static const double MIN_SOLVE_TIME = 1e-3;
 static int const IK_ATTEMPTS = 10;
 static int const IK_TIMEOUT = 0.05;
 const static double MAX_START_DISTANCE_THRESH = 0.5;
@@ -59,6 +59,7 @@ bool parseConfig(XmlRpc::XmlRpcValue config,const moveit::core::JointModelGroup*
   stomp_config.max_rollouts = 100;
   stomp_config.num_rollouts = 10;
   stomp_config.exponentiated_cost_sensitivity = 10.0;
+  stomp_config.num_threads = 1;
 
   // Load optional config parameters if they exist
   if (config.hasMember("control_cost_weight"))
@@ -88,6 +89,36 @@ bool parseConfig(XmlRpc::XmlRpcValue config,const moveit::core::JointModelGroup*
   if (config.hasMember("exponentiated_cost_sensitivity"))
     stomp_config.exponentiated_cost_sensitivity = static_cast<int>(config["exponentiated_cost_sensitivity"]);
 
+  if (config.hasMember("reweight_reused_rollouts"))
+    stomp_config.reweight_reused_rollouts = static_cast<bool>(config["reweight_reused_rollouts"]);
+
+  if (config.hasMember("num_threads"))
+    stomp_config.num_threads = static_cast<int>(config["num_threads"]);
+
+  if (config.hasMember("convergence_iterations"))
+    stomp_config.convergence_iterations = static_cast<int>(config["convergence_iterations"]);
+
+  if (config.hasMember("convergence_threshold"))
+    stomp_config.convergence_threshold = static_cast<double>(config["convergence_threshold"]);
+
+  if (config.hasMember("cost_target"))
+    stomp_config.cost_target = static_cast<double>(config["cost_target"]);
+
+  if (config.hasMember("noise_adaptation_rate"))
+    stomp_config.noise_adaptation_rate = static_cast<double>(config["noise_adaptation_rate"]);
+
+  if (config.hasMember("min_noise_scale"))
+    stomp_config.min_noise_scale = static_cast<double>(config["min_noise_scale"]);
+
+  if (config.hasMember("max_noise_scale"))
+    stomp_config.max_noise_scale = static_cast<double>(config["max_noise_scale"]);
+
+  if (config.hasMember("num_coarse_timesteps"))
+    stomp_config.num_coarse_timesteps = static_cast<int>(config["num_coarse_timesteps"]);
+
+  if (config.hasMember("num_coarse_iterations"))
+    stomp_config.num_coarse_iterations = static_cast<int>(config["num_coarse_iterations"]);
+
   // getting number of joints
   stomp_config.num_dimensions = group->getActiveJointModels().size();
   if(stomp_config.num_dimensions == 0)
@@ -195,21 +226,13 @@ bool StompPlanner::solve(planning_interface::MotionPlanDetailedResponse &res)
   bool use_seed = getSeedParameters(initial_parameters);
 
 
-  // create timeout timer
+  // the optimization stops on its own once the remaining planning time elapses
   ros::WallDuration allowed_time(request_.allowed_planning_time);
-  ROS_WARN_COND(TIMEOUT_INTERVAL > request_.allowed_planning_time,
-                "%s allowed planning time %f is less than the minimum planning time value of %f",
-                getName().c_str(),request_.allowed_planning_time,TIMEOUT_INTERVAL);
-  ros::Timer timeout_timer = ph_->createTimer(ros::Duration(TIMEOUT_INTERVAL), [&](const ros::TimerEvent& evnt)
+  auto setRemainingTime = [&](stomp_core::StompConfiguration& config)
   {
-    if((ros::WallTime::now() - start_time) > allowed_time)
-    {
-      ROS_ERROR("%s exceeded allowed time of %f , terminating",getName().c_str(),allowed_time.toSec());
-      this->terminate();
-    }
-
-  },false);
-
+    double remaining_time = (allowed_time - (ros::WallTime::now() - start_time)).toSec();
+    config.max_solve_time = std::max(remaining_time,MIN_SOLVE_TIME);
+  };
 
   if (use_seed)
   {
@@ -225,6 +248,7 @@ bool StompPlanner::solve(planning_interface::MotionPlanDetailedResponse &res)
       return false;
     }
 
+    setRemainingTime(config_copy);
     stomp_->setConfig(config_copy);
     planning_success = stomp_->solve(initial_parameters, parameters);
   }
@@ -247,13 +271,11 @@ bool StompPlanner::solve(planning_interface::MotionPlanDetailedResponse &res)
       return false;
     }
 
+    setRemainingTime(config_copy);
     stomp_->setConfig(config_copy);
     planning_success = stomp_->solve(start,goal,parameters);
   }
 
-  // stopping timer
-  timeout_timer.stop();
-
   // Handle results
   if(planning_success)
   {
@@ -28,7 +28,7 @@
 #include <stomp_moveit/update_filters/control_cost_projection.h>
 #include <ros/console.h>
 #include <pluginlib/class_list_macros.h>
-#include <stomp_core/utils.h>
+#include <stomp_core/matrix_cache.h>
 
 PLUGINLIB_EXPORT_CLASS(stomp_moveit::update_filters::ControlCostProjection,stomp_moveit::update_filters::StompUpdateFilter);
 
@@ -80,7 +80,7 @@ bool ControlCostProjection::setMotionPlanRequest(const planning_scene::PlanningS
 {
 
   num_timesteps_ = config.num_timesteps;
-  stomp_core::generateSmoothingMatrix(num_timesteps_,DEFAULT_TIME_STEP,projection_matrix_M_);
+  projection_matrix_M_ = *stomp_core::getSmoothingMatrix(num_timesteps_,DEFAULT_TIME_STEP);
 
   // zeroing out first and last rows
   projection_matrix_M_.topRows(1) = Eigen::VectorXd::Zero(num_timesteps_).transpose();
@@ -55,11 +55,13 @@ inline void eigenToPointsMsgs(const Eigen::MatrixXd& in,std::vector<geometry_msg
 
 /**
  * @brief Creates a tool path xyz trajectory from the joint parameters
- * @param state       The robot state
+ * @param cache       The robot states shared by the plugins, the parameters are those of the optimized rollout
+ * @param state       The robot state used when the cache can not serve a timestep
  * @param parameters  The joint parameters [num_dimensions x num_timesteps]
  * @return  The tool path [3 x num_timesteps]
  */
-static Eigen::MatrixXd jointsToToolPath(RobotState& state,const std::string& group_name,const Eigen::MatrixXd& parameters)
+static Eigen::MatrixXd jointsToToolPath(const stomp_moveit::utils::ForwardKinematicsCachePtr& cache,RobotState& state,
+                                        const std::string& group_name,const Eigen::MatrixXd& parameters)
 {
 
   Eigen::MatrixXd tool_traj = Eigen::MatrixXd::Zero(3,parameters.cols());
@@ -67,8 +69,9 @@ static Eigen::MatrixXd jointsToToolPath(RobotState& state,const std::string& gro
   std::string tool_link = joint_group->getLinkModelNames().back();
   for(auto t = 0u; t < parameters.cols();t++)
   {
-    state.setJointGroupPositions(joint_group,parameters.col(t));
-    Eigen::Affine3d tool_pos = state.getFrameTransform(tool_link);
+    const RobotState& tool_state = stomp_moveit::utils::getRolloutState(
+        cache,stomp_moveit::utils::ForwardKinematicsCache::OPTIMIZED_ROLLOUT,t,parameters.col(t),joint_group,state);
+    Eigen::Affine3d tool_pos = tool_state.getFrameTransform(tool_link);
     tool_traj(0,t) = tool_pos.translation()(0);
     tool_traj(1,t) = tool_pos.translation()(1);
     tool_traj(2,t) = tool_pos.translation()(2);
@@ -232,7 +235,7 @@ bool TrajectoryVisualization::filter(std::size_t start_timestep,
   if(publish_intermediate_)
   {
     Eigen::MatrixXd updated_parameters = parameters + updates;
-    tool_traj_line_ = jointsToToolPath(*state_,group_name_,updated_parameters);
+    tool_traj_line_ = jointsToToolPath(kinematics_cache_,*state_,group_name_,updated_parameters);
     eigenToPointsMsgs(tool_traj_line_,tool_traj_marker_.points);
     viz_pub_.publish(tool_traj_marker_);
   }
@@ -243,7 +246,7 @@ bool TrajectoryVisualization::filter(std::size_t start_timestep,
 void TrajectoryVisualization::done(bool success,int total_iterations,double final_cost,const Eigen::MatrixXd& parameters)
 {
 
-  tool_traj_line_ = jointsToToolPath(*state_,group_name_,parameters);
+  tool_traj_line_ = jointsToToolPath(kinematics_cache_,*state_,group_name_,parameters);
   eigenToPointsMsgs(tool_traj_line_,tool_traj_marker_.points);
 
   if(!success)
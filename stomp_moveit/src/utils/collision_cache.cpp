@@ -0,0 +1,157 @@
+/**
+ * @file collision_cache.cpp
+ * @brief This contains a cache of the collision check results of joint configurations
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stomp_moveit/utils/collision_cache.h>
+#include <cmath>
+
+/**
+ * @namespace stomp_moveit
+ */
+namespace stomp_moveit
+{
+
+/**
+ * @namespace utils
+ */
+namespace utils
+{
+
+std::size_t CollisionCache::KeyHash::operator()(const Key& key) const
+{
+  std::size_t seed = key.size();
+  for(std::int64_t v : key)
+  {
+    seed ^= std::hash<std::int64_t>()(v) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+  }
+  return seed;
+}
+
+CollisionCache::CollisionCache():
+    capacity_(0),
+    resolution_(1e-3),
+    scene_version_(0)
+{
+
+}
+
+bool CollisionCache::configure(std::size_t capacity,double resolution)
+{
+  if(resolution <= 0)
+  {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  capacity_ = capacity;
+  resolution_ = resolution;
+  entries_.clear();
+  index_.clear();
+  index_.reserve(capacity);
+  statistics_ = CollisionCacheStatistics();
+  return true;
+}
+
+void CollisionCache::invalidate()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  scene_version_++;
+  entries_.clear();
+  index_.clear();
+  statistics_.invalidations++;
+}
+
+void CollisionCache::computeKey(const Eigen::VectorXd& joint_pose,Key& key) const
+{
+  key.resize(joint_pose.size() + 1);
+  key[0] = scene_version_;
+  for(auto i = 0u; i < joint_pose.size(); i++)
+  {
+    key[i + 1] = std::llround(joint_pose(i)/resolution_);
+  }
+}
+
+bool CollisionCache::lookup(const Eigen::VectorXd& joint_pose,double& result)
+{
+  if(!isEnabled())
+  {
+    return false;
+  }
+
+  Key key;
+  std::lock_guard<std::mutex> lock(mutex_);
+  computeKey(joint_pose,key);
+  auto it = index_.find(key);
+  if(it == index_.end())
+  {
+    statistics_.misses++;
+    return false;
+  }
+
+  // moving to the front as the most recently used
+  entries_.splice(entries_.begin(),entries_,it->second);
+  result = it->second->second;
+  statistics_.hits++;
+  return true;
+}
+
+void CollisionCache::insert(const Eigen::VectorXd& joint_pose,double result)
+{
+  if(!isEnabled())
+  {
+    return;
+  }
+
+  Key key;
+  std::lock_guard<std::mutex> lock(mutex_);
+  computeKey(joint_pose,key);
+  auto it = index_.find(key);
+  if(it != index_.end())
+  {
+    // another thread stored it first
+    entries_.splice(entries_.begin(),entries_,it->second);
+    it->second->second = result;
+    return;
+  }
+
+  if(entries_.size() >= capacity_)
+  {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+    statistics_.evictions++;
+  }
+
+  entries_.emplace_front(key,result);
+  index_.emplace(std::move(key),entries_.begin());
+}
+
+CollisionCacheStatistics CollisionCache::getStatistics() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+} /* namespace utils */
+} /* namespace stomp_moveit */
@@ -0,0 +1,122 @@
+/**
+ * @file forward_kinematics_cache.cpp
+ * @brief This contains the robot states of the rollout timesteps shared by the plugins of a task
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stomp_moveit/utils/forward_kinematics_cache.h>
+#include <algorithm>
+
+/**
+ * @namespace stomp_moveit
+ */
+namespace stomp_moveit
+{
+
+/**
+ * @namespace utils
+ */
+namespace utils
+{
+
+const int ForwardKinematicsCache::OPTIMIZED_ROLLOUT;
+
+ForwardKinematicsCache::ForwardKinematicsCache(moveit::core::RobotModelConstPtr robot_model,
+                                               const std::string& group_name):
+    robot_model_(robot_model),
+    joint_group_(robot_model->getJointModelGroup(group_name)),
+    num_timesteps_(0),
+    hits_(0),
+    misses_(0)
+{
+
+}
+
+void ForwardKinematicsCache::reset(const moveit::core::RobotState& start_state,int num_rollouts,int num_timesteps)
+{
+  start_state_.reset(new moveit::core::RobotState(start_state));
+  num_timesteps_ = std::max(num_timesteps,0);
+  slots_.clear();
+  // the rollouts in [OPTIMIZED_ROLLOUT, num_rollouts), the optimized one first
+  slots_.resize((std::max(num_rollouts,0) + 1)*num_timesteps_);
+  hits_ = 0;
+  misses_ = 0;
+}
+
+const moveit::core::RobotState* ForwardKinematicsCache::getState(int rollout_number,std::size_t timestep,
+                                                                 const Eigen::VectorXd& joint_pose)
+{
+  if(rollout_number < OPTIMIZED_ROLLOUT || timestep >= num_timesteps_)
+  {
+    return nullptr;
+  }
+
+  std::size_t index = (rollout_number - OPTIMIZED_ROLLOUT)*num_timesteps_ + timestep;
+  if(index >= slots_.size())
+  {
+    return nullptr;
+  }
+
+  Slot& slot = slots_[index];
+  if(slot.state && slot.joint_pose.size() == joint_pose.size() && slot.joint_pose == joint_pose)
+  {
+    hits_++;
+    return slot.state.get();
+  }
+
+  if(!slot.state)
+  {
+    slot.state.reset(new moveit::core::RobotState(*start_state_));
+  }
+
+  slot.joint_pose = joint_pose;
+  slot.state->setJointGroupPositions(joint_group_,joint_pose);
+  slot.state->update();
+  misses_++;
+  return slot.state.get();
+}
+
+void ForwardKinematicsCache::getStatistics(std::size_t& hits,std::size_t& misses) const
+{
+  hits = hits_;
+  misses = misses_;
+}
+
+const moveit::core::RobotState& getRolloutState(const ForwardKinematicsCachePtr& cache,int rollout_number,
+                                                std::size_t timestep,const Eigen::VectorXd& joint_pose,
+                                                const moveit::core::JointModelGroup* joint_group,
+                                                moveit::core::RobotState& state)
+{
+  const moveit::core::RobotState* cached_state = cache ? cache->getState(rollout_number,timestep,joint_pose) : nullptr;
+  if(cached_state)
+  {
+    return *cached_state;
+  }
+
+  state.setJointGroupPositions(joint_group,joint_pose);
+  state.update();
+  return state;
+}
+
+} /* namespace utils */
+} /* namespace stomp_moveit */
@@ -0,0 +1,276 @@
+/**
+ * @file segment_collision_check.cpp
+ * @brief This contains a continuous collision check of the straight joint motion between two poses
+ *
+ * @author Jorge Nicho
+ * @date October 16, 2026
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stomp_moveit/utils/segment_collision_check.h>
+#include <geometric_shapes/shape_operations.h>
+#include <ros/console.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+/**
+ * @namespace stomp_moveit
+ */
+namespace stomp_moveit
+{
+
+/**
+ * @namespace utils
+ */
+namespace utils
+{
+
+double computeLinkRadius(const moveit::core::LinkModel* link,const moveit::core::RobotState& state)
+{
+  double radius = 0;
+  auto add_shapes = [&radius](const std::vector<shapes::ShapeConstPtr>& shapes,const EigenSTL::vector_Affine3d& poses)
+  {
+    for(auto i = 0u; i < shapes.size(); i++)
+    {
+      Eigen::Vector3d center;
+      double shape_radius;
+      shapes::computeShapeBoundingSphere(shapes[i].get(),center,shape_radius);
+      radius = std::max(radius,(poses[i]*center).norm() + shape_radius);
+    }
+  };
+
+  add_shapes(link->getShapes(),link->getCollisionOriginTransforms());
+
+  std::vector<const moveit::core::AttachedBody*> attached_bodies;
+  state.getAttachedBodies(attached_bodies);
+  for(const auto* body : attached_bodies)
+  {
+    if(body->getAttachedLink() == link)
+    {
+      add_shapes(body->getShapes(),body->getFixedTransforms());
+    }
+  }
+
+  return radius;
+}
+
+double computeChainReach(const moveit::core::LinkModel* ancestor,const moveit::core::LinkModel* descendant)
+{
+  double reach = 0;
+  for(const moveit::core::LinkModel* link = descendant; link && link != ancestor; link = link->getParentLinkModel())
+  {
+    reach += link->getJointOriginTransform().translation().norm();
+    const moveit::core::JointModel* joint = link->getParentJointModel();
+    if(joint->getType() == moveit::core::JointModel::PRISMATIC)
+    {
+      const moveit::core::VariableBounds& bounds = joint->getVariableBounds()[0];
+      reach += std::max(std::abs(bounds.min_position_),std::abs(bounds.max_position_));
+    }
+  }
+
+  return reach;
+}
+
+SegmentCollisionCheck::SegmentCollisionCheck()
+{
+
+}
+
+bool SegmentCollisionCheck::initialize(moveit::core::RobotModelConstPtr robot_model,
+                                       const planning_scene::PlanningScene& planning_scene,
+                                       const std::string& group_name,const moveit::core::RobotState& state)
+{
+  using namespace moveit::core;
+
+  group_name_ = group_name;
+  joint_motion_bounds_.clear();
+  const JointModelGroup* joint_group = robot_model->getJointModelGroup(group_name);
+  if(!joint_group)
+  {
+    ROS_ERROR("Invalid joint group %s",group_name.c_str());
+    return false;
+  }
+
+  std::vector<double> bounds;
+  for(const JointModel* joint : joint_group->getActiveJointModels())
+  {
+    switch(joint->getType())
+    {
+      case JointModel::PRISMATIC:
+        bounds.push_back(1.0);
+        break;
+
+      case JointModel::REVOLUTE:
+      {
+        // the geometry below the joint turns about an axis through the frame of its child link
+        double reach = 0;
+        const LinkModel* child = joint->getChildLinkModel();
+        for(const LinkModel* link : joint->getDescendantLinkModels())
+        {
+          reach = std::max(reach,computeChainReach(child,link) + computeLinkRadius(link,state));
+        }
+        bounds.push_back(reach);
+        break;
+      }
+
+      default:
+        ROS_WARN("Joint '%s' is neither revolute nor prismatic, continuous segment checks are disabled",
+                 joint->getName().c_str());
+        return false;
+    }
+  }
+
+  // the links and attached bodies that do not move with the group are left out of the distance queries
+  std::vector<std::string> static_names = robot_model->getLinkModelNamesWithCollisionGeometry();
+  for(const LinkModel* link : joint_group->getUpdatedLinkModelsWithGeometry())
+  {
+    static_names.erase(std::remove(static_names.begin(),static_names.end(),link->getName()),static_names.end());
+  }
+
+  std::vector<const AttachedBody*> attached_bodies;
+  state.getAttachedBodies(attached_bodies);
+  for(const AttachedBody* body : attached_bodies)
+  {
+    if(!joint_group->isLinkUpdated(body->getAttachedLinkName()))
+    {
+      static_names.push_back(body->getName());
+    }
+  }
+
+  world_acm_ = planning_scene.getAllowedCollisionMatrix();
+  world_acm_.setEntry(static_names,planning_scene.getWorld()->getObjectIds(),true);
+  for(const std::string& name : static_names)
+  {
+    world_acm_.setDefaultEntry(name,true);
+  }
+
+  self_acm_ = planning_scene.getAllowedCollisionMatrix();
+  self_acm_.setEntry(static_names,static_names,true);
+
+  joint_motion_bounds_ = bounds;
+  return true;
+}
+
+double SegmentCollisionCheck::getMotionBound(const Eigen::VectorXd& start,const Eigen::VectorXd& end) const
+{
+  double bound = 0;
+  for(auto j = 0u; j < joint_motion_bounds_.size(); j++)
+  {
+    bound += joint_motion_bounds_[j]*std::abs(end(j) - start(j));
+  }
+
+  return bound;
+}
+
+double SegmentCollisionCheck::computeClearance(const planning_scene::PlanningScene& planning_scene,
+                                               const Eigen::VectorXd& joint_pose,moveit::core::RobotState& state,
+                                               CollisionCache* cache) const
+{
+  double clearance;
+  if(cache && cache->lookup(joint_pose,clearance))
+  {
+    // the clearance may belong to another pose of the quantization cell, which is at most a cell away in each joint
+    if(clearance > 0)
+    {
+      double cell_motion_bound = cache->getResolution()*
+          std::accumulate(joint_motion_bounds_.begin(),joint_motion_bounds_.end(),0.0);
+      clearance = std::max(clearance - cell_motion_bound,0.0);
+    }
+    return clearance;
+  }
+
+  state.setJointGroupPositions(group_name_,joint_pose);
+  state.update();
+
+  clearance = std::min(planning_scene.getCollisionWorld()->distanceRobot(*planning_scene.getCollisionRobot(),state,
+                                                                          world_acm_),
+                       0.5*planning_scene.getCollisionRobot()->distanceSelf(state,self_acm_));
+
+  // the distance queries do not always report penetration, the collision check of the group is authoritative near contact
+  if(clearance <= 0)
+  {
+    clearance = planning_scene.isStateColliding(state,group_name_) ? -1.0 : 0.0;
+  }
+
+  if(cache)
+  {
+    cache->insert(joint_pose,clearance);
+  }
+
+  return clearance;
+}
+
+bool SegmentCollisionCheck::isSegmentCollisionFree(const planning_scene::PlanningScene& planning_scene,
+                                                   const Eigen::VectorXd& start,const Eigen::VectorXd& end,
+                                                   double longest_valid_joint_move,moveit::core::RobotState& state,
+                                                   CollisionCache* cache) const
+{
+  // an interval [s0, s1] of the segment start + s*(end - start) with the clearances at its ends
+  struct Interval
+  {
+    double s0, d0, s1, d1;
+  };
+
+  Eigen::VectorXd diff = end - start;
+  double max_joint_move = diff.cwiseAbs().maxCoeff();
+  if(max_joint_move <= longest_valid_joint_move)
+  {
+    // no interpolation needed
+    return true;
+  }
+
+  double motion_bound = getMotionBound(start,end);
+  double min_interval = longest_valid_joint_move/max_joint_move;
+
+  // the end poses are not part of the segment, a collision there only prevents certifying the adjacent intervals
+  std::vector<Interval> intervals;
+  intervals.push_back({0.0,std::max(computeClearance(planning_scene,start,state,cache),0.0),
+                       1.0,std::max(computeClearance(planning_scene,end,state,cache),0.0)});
+  Eigen::VectorXd pose;
+  while(!intervals.empty())
+  {
+    Interval interval = intervals.back();
+    intervals.pop_back();
+
+    // every pose within the interval is closer than the motion bound to one of its ends
+    double length = interval.s1 - interval.s0;
+    if(interval.d0 + interval.d1 > length*motion_bound || length <= min_interval)
+    {
+      continue;
+    }
+
+    double s = 0.5*(interval.s0 + interval.s1);
+    pose = start + s*diff;
+    double d = computeClearance(planning_scene,pose,state,cache);
+    if(d < 0)
+    {
+      return false;
+    }
+
+    intervals.push_back({interval.s0,interval.d0,s,d});
+    intervals.push_back({s,d,interval.s1,interval.d1});
+  }
+
+  return true;
+}
+
+} /* namespace utils */
+} /* namespace stomp_moveit */
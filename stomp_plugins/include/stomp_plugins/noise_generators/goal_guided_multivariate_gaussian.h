@@ -37,9 +37,6 @@ namespace stomp_moveit
 namespace noise_generators
 {
 
-typedef boost::mt19937 RGNType;
-typedef boost::variate_generator< RGNType, boost::uniform_real<> > RandomGenerator;
-
 /**
  * @class stomp_moveit::noise_generators::GoalGuidedMultivariateGaussian
  * @brief This class generates noisy trajectories to an under-constrained cartesian goal pose.
@@ -137,7 +134,8 @@ protected:
                    const stomp_core::StompConfiguration &config,
                    moveit_msgs::MoveItErrorCodes& error_code);
 
-  virtual bool generateRandomGoal(const Eigen::VectorXd& seed,Eigen::VectorXd& goal_joint_pose);
+  virtual bool generateRandomGoal(const Eigen::VectorXd& seed,stomp_core::RandomStream& stream,
+                                  Eigen::VectorXd& goal_joint_pose);
 
 protected:
 
@@ -152,13 +150,13 @@ protected:
   utils::kinematics::KinematicConfig kc_;                             /**< @brief The kinematic configuration to find valid goal poses **/
 
   // noisy trajectory generation
-  std::vector<utils::MultivariateGaussianPtr> traj_noise_generators_; /**< @brief Randomized numerical distribution generators, [6 x 1] **/
+  utils::MultivariateGaussianPtr traj_noise_generator_;               /**< @brief Randomized numerical distribution generator shared by all joints **/
   Eigen::VectorXd raw_noise_;                                         /**< @brief The noise vector **/
   std::vector<double> stddev_;                                        /**< @brief The standard deviations applied to each joint, [num_dimensions x 1 **/
   std::vector<double> goal_stddev_;                                   /**< @brief The standard deviations applied to each cartesian dimension at the goal, [6 x 1] **/
 
   // random goal generation
-  boost::shared_ptr<RandomGenerator> goal_rand_generator_;            /**< @brief Random generator for the tool goal pose **/
+  std::uint64_t seed_;                                                /**< @brief Seed of the random streams, each (iteration, rollout, joint) and the goal sample their own stream **/
 
   // robot
   moveit::core::RobotModelConstPtr robot_model_;
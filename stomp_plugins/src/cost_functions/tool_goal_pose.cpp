@@ -223,8 +223,11 @@ bool ToolGoalPose::computeCosts(const Eigen::MatrixXd& parameters,
   costs.setConstant(0.0);
 
   last_joint_pose_ = parameters.rightCols(1);
-  state_->setJointGroupPositions(group_name_,last_joint_pose_);
-  last_tool_pose_ = state_->getGlobalLinkTransform(tool_link_);
+  const moveit::core::RobotState& state = stomp_moveit::utils::getRolloutState(kinematics_cache_,rollout_number,
+                                                                             parameters.cols() - 1,last_joint_pose_,
+                                                                             state_->getJointModelGroup(group_name_),
+                                                                             *state_);
+  last_tool_pose_ = state.getGlobalLinkTransform(tool_link_);
 
   computeTwist(last_tool_pose_,tool_goal_pose_,dof_nullity_,tool_twist_error_);
 
@@ -26,6 +26,7 @@
 
 #include "stomp_plugins/noise_generators/goal_guided_multivariate_gaussian.h"
 #include <stomp_moveit/utils/multivariate_gaussian.h>
+#include <stomp_core/matrix_cache.h>
 #include <XmlRpcException.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/package.h>
@@ -52,7 +53,7 @@ namespace noise_generators
 
 GoalGuidedMultivariateGaussian::GoalGuidedMultivariateGaussian():
   name_("GoalGuidedMultivariateGaussian"),
-  goal_rand_generator_(new RandomGenerator(RGNType(),boost::uniform_real<>(-1,1)))
+  seed_(0)
 {
 
 }
@@ -144,6 +145,12 @@ bool GoalGuidedMultivariateGaussian::configure(const XmlRpc::XmlRpcValue& config
       kc_.constrained_dofs(i) = static_cast<int>(dof_nullity_param[i]);
     }
 
+    // optional seed of the random streams
+    if(params.hasMember("seed"))
+    {
+      seed_ = static_cast<int>(params["seed"]);
+    }
+
   }
   catch(XmlRpc::XmlRpcException& e)
   {
@@ -172,35 +179,43 @@ bool GoalGuidedMultivariateGaussian::setNoiseGeneration(const planning_scene::Pl
 {
   using namespace Eigen;
 
-  // convenience lambda function to fill matrix
-  auto fill_diagonal = [](Eigen::MatrixXd& m,double coeff,int diag_index)
-  {
-    std::size_t size = m.rows() - std::abs(diag_index);
-    m.diagonal(diag_index) = VectorXd::Constant(size,coeff);
-  };
-
-  // creating finite difference acceleration matrix
+  // creating the covariance from the finite difference acceleration matrix, it is scaled so it does not depend on dt
   std::size_t num_timesteps = config.num_timesteps;
-  Eigen::MatrixXd A = MatrixXd::Zero(num_timesteps,num_timesteps);
-  int num_elements = (int((ACC_MATRIX_DIAGONAL_INDICES.size() -1)/2.0) + 1)* num_timesteps ;
-  for(auto i = 0u; i < ACC_MATRIX_DIAGONAL_INDICES.size() ; i++)
+  stomp_core::MatrixConstPtr covariance = stomp_core::getCachedMatrix(
+      "noise_generators/acceleration_covariance",num_timesteps,1.0,stomp_core::DerivativeOrders::STOMP_ACCELERATION,
+      [num_timesteps](Eigen::MatrixXd& covariance)
   {
-    fill_diagonal(A,ACC_MATRIX_DIAGONAL_VALUES[i],ACC_MATRIX_DIAGONAL_INDICES[i]);
-  }
+    // convenience lambda function to fill matrix
+    auto fill_diagonal = [](Eigen::MatrixXd& m,double coeff,int diag_index)
+    {
+      std::size_t size = m.rows() - std::abs(diag_index);
+      m.diagonal(diag_index) = VectorXd::Constant(size,coeff);
+    };
+
+    // creating finite difference acceleration matrix
+    Eigen::MatrixXd A = MatrixXd::Zero(num_timesteps,num_timesteps);
+    for(auto i = 0u; i < ACC_MATRIX_DIAGONAL_INDICES.size() ; i++)
+    {
+      fill_diagonal(A,ACC_MATRIX_DIAGONAL_VALUES[i],ACC_MATRIX_DIAGONAL_INDICES[i]);
+    }
 
-  // create and scale covariance matrix
-  Eigen::MatrixXd covariance = MatrixXd::Identity(num_timesteps,num_timesteps);
-  covariance = A.transpose() * A;
-  covariance = covariance.fullPivLu().inverse();
-  double max_val = covariance.array().abs().matrix().maxCoeff();
-  covariance /= max_val;
+    // create and scale covariance matrix
+    covariance = A.transpose() * A;
+    covariance = covariance.fullPivLu().inverse();
+    double max_val = covariance.array().abs().matrix().maxCoeff();
+    covariance /= max_val;
+  });
 
-  // create random generators
-  traj_noise_generators_.resize(stddev_.size());
-  for(auto& r: traj_noise_generators_)
+  stomp_core::MatrixConstPtr covariance_cholesky = stomp_core::getCachedMatrix(
+      "noise_generators/acceleration_covariance_cholesky",num_timesteps,1.0,
+      stomp_core::DerivativeOrders::STOMP_ACCELERATION,[&covariance](Eigen::MatrixXd& cholesky)
   {
-    r.reset(new utils::MultivariateGaussian(VectorXd::Zero(num_timesteps),covariance));
-  }
+    cholesky = covariance->llt().matrixL();
+  });
+
+  // create the random generator, the joints only differ in the random stream they sample from
+  traj_noise_generator_.reset(new utils::MultivariateGaussian(VectorXd::Zero(num_timesteps),*covariance,
+                                                              *covariance_cholesky,seed_));
 
   // preallocating noise data
   raw_noise_.resize(config.num_timesteps);
@@ -251,7 +266,9 @@ bool GoalGuidedMultivariateGaussian::generateNoise(const Eigen::MatrixXd& parame
     return false;
   }
 
-  if(generateRandomGoal(parameters.rightCols(1),goal_joint_pose))
+  // the goal samples the stream indexed after the last joint
+  stomp_core::RandomStream stream(seed_,iteration_number,rollout_number,parameters.rows());
+  if(generateRandomGoal(parameters.rightCols(1),stream,goal_joint_pose))
   {
     goal_joint_noise = goal_joint_pose - parameters.rightCols(1);
   }
@@ -265,7 +282,8 @@ bool GoalGuidedMultivariateGaussian::generateNoise(const Eigen::MatrixXd& parame
   int sign;
   for(auto d = 0u; d < parameters.rows() ; d++)
   {
-    traj_noise_generators_[d]->sample(raw_noise_,true);
+    stream.reset(seed_,iteration_number,rollout_number,d);
+    traj_noise_generator_->sample(raw_noise_,stream,true);
 
     // shifting data towards goal
     sign = goal_joint_noise(d) > 0 ? 1 : -1;
@@ -278,7 +296,9 @@ bool GoalGuidedMultivariateGaussian::generateNoise(const Eigen::MatrixXd& parame
   return true;
 }
 
-bool GoalGuidedMultivariateGaussian::generateRandomGoal(const Eigen::VectorXd& seed_joint_pose,Eigen::VectorXd& goal_joint_pose)
+bool GoalGuidedMultivariateGaussian::generateRandomGoal(const Eigen::VectorXd& seed_joint_pose,
+                                                        stomp_core::RandomStream& stream,
+                                                        Eigen::VectorXd& goal_joint_pose)
 {
   using namespace Eigen;
   using namespace moveit::core;
@@ -288,7 +308,7 @@ bool GoalGuidedMultivariateGaussian::generateRandomGoal(const Eigen::VectorXd& s
   Eigen::VectorXd noise = Eigen::VectorXd::Zero(CARTESIAN_DOF_SIZE);
   for(auto d = 0u; d < noise.size(); d++)
   {
-    noise(d) = goal_stddev_[d]*(*goal_rand_generator_)();
+    noise(d) = goal_stddev_[d]*stream.nextUniform(-1,1);
   }
 
   // applying noise onto tool pose